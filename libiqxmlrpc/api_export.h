@@ -24,4 +24,10 @@
   #define LIBIQXMLRPC_API
 #endif // LIBIQXMLRPC_DLL
 
+// Move constructors and rvalue overloads are declared only when compiler
+// supports them, so headers are still usable by C++03 code.
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1600)
+  #define LIBIQXMLRPC_HAS_RVALUE_REFS
+#endif
+
 #endif
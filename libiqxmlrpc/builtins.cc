@@ -18,5 +18,22 @@ void List_methods::execute(const Param_list&, Value& resp)
   disp_manager_->get_methods_list(resp.the_array());
 }
 
+Method_signature::Method_signature(Method_dispatcher_manager* disp_manager):
+  disp_manager_(disp_manager)
+{
+}
+
+void Method_signature::execute(const Param_list& params, Value& resp)
+{
+  if (params.size() != 1 || !params[0].is_string())
+    throw Invalid_meth_params();
+
+  Array sigs;
+  if (disp_manager_->get_method_signature(params[0].get_string(), sigs))
+    resp = sigs;
+  else
+    resp = "undef";
+}
+
 } // namespace builtins
 } // namespace iqxmlrpc
@@ -24,6 +24,18 @@ private:
   void execute( const Param_list& params, Value& response );
 };
 
+//! Implementation of system.methodSignature
+//! Returns "undef" string for methods without known signature.
+class LIBIQXMLRPC_API Method_signature: public Method {
+  Method_dispatcher_manager* disp_manager_;
+
+public:
+  Method_signature(Method_dispatcher_manager*);
+
+private:
+  void execute( const Param_list& params, Value& response );
+};
+
 } // namespace builtins
 } // namespace iqxmlrpc
 
@@ -119,6 +119,11 @@ void Client_base::set_keep_alive( bool keep_alive )
     impl_->conn_cache.reset();
 }
 
+void Client_base::set_lazy_responses( bool lazy )
+{
+  impl_->opts.set_lazy_responses(lazy);
+}
+
 void Client_base::set_authinfo( const std::string& u, const std::string& p )
 {
   impl_->opts.set_authinfo( u, p );
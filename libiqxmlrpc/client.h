@@ -54,6 +54,10 @@ public:
   //! Set connection keep-alive flag
   void set_keep_alive( bool keep_alive );
 
+  //! Decode response values on demand.
+  /*! \see parse_response_lazy */
+  void set_lazy_responses( bool lazy );
+
   //! Set data for HTTP Basic authentication
   void set_authinfo(const std::string& user, const std::string& password);
 
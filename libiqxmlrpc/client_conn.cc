@@ -20,8 +20,6 @@ Response Client_connection::process_session( const Request& req, const XHeaders&
 {
   using namespace http;
 
-  std::string req_xml_str( dump_request(req) );
-
   std::auto_ptr<Request_header> req_h(
     new Request_header(
       decorate_uri(),
@@ -34,11 +32,13 @@ Response Client_connection::process_session( const Request& req, const XHeaders&
   req_h->set_xheaders( opts().xheaders() );
   req_h->set_xheaders( xheaders );
 
-  Packet req_p( req_h.release(), req_xml_str );
+  Packet req_p( req_h.release(), dump_request(req) );
   req_p.set_keep_alive( opts().keep_alive() );
 
   // Received packet
-  std::auto_ptr<Packet> res_p( do_process_session(req_p.dump()) );
+  iqnet::Send_queue out;
+  req_p.dump( out );
+  std::auto_ptr<Packet> res_p( do_process_session(out) );
 
   const Response_header* res_h =
     static_cast<const Response_header*>(res_p->header());
@@ -46,6 +46,12 @@ Response Client_connection::process_session( const Request& req, const XHeaders&
   if( res_h->code() != 200 )
     throw Error_response( res_h->phrase(), res_h->code() );
 
+  if (opts().lazy_responses())
+  {
+    boost::shared_ptr<const std::string> buf(new std::string(res_p->content()));
+    return parse_response_lazy( buf );
+  }
+
   return parse_response( res_p->content() );
 }
 
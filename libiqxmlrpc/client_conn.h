@@ -26,7 +26,8 @@ public:
 
 protected:
   http::Packet* read_response( const std::string&, bool read_hdr_only = false );
-  virtual http::Packet* do_process_session( const std::string& ) = 0;
+  //! Sends queued request and reads response.
+  virtual http::Packet* do_process_session( iqnet::Send_queue& ) = 0;
 
   const Client_options& opts() const { return *options; }
 
@@ -22,7 +22,8 @@ public:
     vhost_(vhost.empty() ? addr.get_host_name() : vhost),
     keep_alive_(false),
     timeout_(-1),
-    non_blocking_flag_(false)
+    non_blocking_flag_(false),
+    lazy_responses_(false)
   {
   }
 
@@ -32,6 +33,7 @@ public:
   int                      timeout()      const { return timeout_; }
   bool                     non_blocking() const { return non_blocking_flag_; }
   bool                     keep_alive()   const { return keep_alive_; }
+  bool                     lazy_responses() const { return lazy_responses_; }
 
   bool                     has_authinfo() const { return !auth_user_.empty(); }
   const std::string&       auth_user()    const { return auth_user_; }
@@ -49,6 +51,11 @@ public:
     keep_alive_ = keep_alive;
   }
 
+  void set_lazy_responses( bool lazy )
+  {
+    lazy_responses_ = lazy;
+  }
+
   void set_authinfo( const std::string& user, const std::string& password )
   {
     auth_user_ = user;
@@ -68,6 +75,7 @@ private:
 
   int              timeout_;
   bool             non_blocking_flag_;
+  bool             lazy_responses_;
 
   std::string      auth_user_;
   std::string      auth_passwd_;
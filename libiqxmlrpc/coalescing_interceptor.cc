@@ -0,0 +1,254 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "coalescing_interceptor.h"
+#include "except.h"
+#include "value_hash.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <memory>
+#include <set>
+
+namespace iqxmlrpc {
+
+typedef boost::mutex::scoped_lock scoped_lock;
+
+namespace {
+
+//! Call in progress.
+struct Flight {
+  Flight(const std::string& m, const std::string& u, const Param_list& p):
+    method(m), user(u), params(p), waiters(0), done(false),
+    result(Nil()), failed(false), fault_code(0) {}
+
+  bool matches(const Method& m, const Param_list& p) const
+  {
+    return method == m.name() && user == m.authname() && params == p;
+  }
+
+  std::string method;
+  std::string user;
+  Param_list params;
+  unsigned waiters;
+
+  boost::condition finished;
+  bool done;
+  Value result;
+  bool failed;
+  int fault_code;
+  std::string fault_string;
+};
+
+typedef boost::shared_ptr<Flight> Flight_ptr;
+
+//! Looks for generated arrays without traversing them.
+bool has_generated_arrays(const Value& v)
+{
+  if (v.is_generated_array())
+    return true;
+
+  if (v.is_array() && !v.the_array().packed())
+  {
+    const Array& a = v.the_array();
+    for (Array::const_iterator i = a.begin(); i != a.end(); ++i)
+      if (has_generated_arrays(*i))
+        return true;
+  }
+
+  if (v.is_struct())
+  {
+    const Struct& s = v.the_struct();
+    for (Struct::const_iterator i = s.begin(); i != s.end(); ++i)
+      if (has_generated_arrays(*i->second))
+        return true;
+  }
+
+  return false;
+}
+
+} // anonymous namespace
+
+//
+// Coalescing_interceptor::Impl
+//
+
+class Coalescing_interceptor::Impl {
+public:
+  Impl():
+    coalesced(0) {}
+
+  //! Returns call in progress or registers new one.
+  //! Caller becomes leader when new call was registered.
+  Flight_ptr join(size_t h, const Method& m, const Param_list& params, bool& leader)
+  {
+    scoped_lock lk(lock);
+
+    std::pair<Flights::iterator, Flights::iterator> r = flights.equal_range(h);
+    for (Flights::iterator i = r.first; i != r.second; ++i)
+    {
+      if (i->second->matches(m, params))
+      {
+        leader = false;
+        ++i->second->waiters;
+        return i->second;
+      }
+    }
+
+    // Copies of parameters must not refer to request's arena.
+    Value_arena::Scope no_arena(0);
+    Flight_ptr f(new Flight(m.name(), m.authname(), params));
+    flights.insert(std::make_pair(h, f));
+    leader = true;
+    return f;
+  }
+
+  //! Unregisters the call. Returns number of waiting calls.
+  unsigned land(size_t h, const Flight_ptr& f)
+  {
+    scoped_lock lk(lock);
+
+    std::pair<Flights::iterator, Flights::iterator> r = flights.equal_range(h);
+    for (Flights::iterator i = r.first; i != r.second; ++i)
+    {
+      if (i->second == f)
+      {
+        flights.erase(i);
+        break;
+      }
+    }
+
+    return f->waiters;
+  }
+
+  void finish(const Flight_ptr& f, const Value& result)
+  {
+    scoped_lock lk(lock);
+    f->result = result;
+    f->done = true;
+    f->finished.notify_all();
+  }
+
+  void fail(const Flight_ptr& f, int code, const std::string& msg)
+  {
+    scoped_lock lk(lock);
+    f->failed = true;
+    f->fault_code = code;
+    f->fault_string = msg;
+    f->done = true;
+    f->finished.notify_all();
+  }
+
+  void wait(const Flight_ptr& f, Value& result)
+  {
+    scoped_lock lk(lock);
+    while (!f->done)
+      f->finished.wait(lk);
+
+    ++coalesced;
+    if (f->failed)
+      throw Fault(f->fault_code, f->fault_string);
+
+    result = f->result;
+  }
+
+  typedef boost::unordered_multimap<size_t, Flight_ptr> Flights;
+
+  boost::mutex lock;
+  Flights flights;
+  std::set<std::string> methods;
+  boost::detail::atomic_count coalesced;
+};
+
+//
+// Coalescing_interceptor
+//
+
+Coalescing_interceptor::Coalescing_interceptor():
+  impl_(new Impl)
+{
+}
+
+Coalescing_interceptor::~Coalescing_interceptor()
+{
+}
+
+void Coalescing_interceptor::coalesce_method(const std::string& name)
+{
+  impl_->methods.insert(name);
+}
+
+size_t Coalescing_interceptor::coalesced() const
+{
+  return impl_->coalesced;
+}
+
+void Coalescing_interceptor::process(Method* m, const Param_list& params, Value& result)
+{
+  if (!impl_->methods.count(m->name()) || dynamic_cast<Streaming_method*>(m))
+  {
+    yield(m, params, result);
+    return;
+  }
+
+  size_t h = call_hash(m->name(), params);
+  bool leader = false;
+  Flight_ptr flight = impl_->join(h, *m, params, leader);
+
+  if (!leader)
+  {
+    impl_->wait(flight, result);
+    return;
+  }
+
+  try {
+    yield(m, params, result);
+  }
+  catch (const iqxmlrpc::Exception& e)
+  {
+    impl_->land(h, flight);
+    impl_->fail(flight, e.code(), e.what());
+    throw;
+  }
+  catch (const std::exception& e)
+  {
+    impl_->land(h, flight);
+    impl_->fail(flight, -1, e.what());
+    throw;
+  }
+  catch (...)
+  {
+    impl_->land(h, flight);
+    impl_->fail(flight, -1, "Unknown Error");
+    throw;
+  }
+
+  if (!impl_->land(h, flight))
+    return;
+
+  // Waiting calls share serialized bytes instead of the tree.
+  // Leader's result is kept as is for outer interceptors, unless
+  // serialization has consumed its generated arrays.
+  Value_arena::Scope no_arena(0);
+  std::auto_ptr<Value> shared;
+  try {
+    bool generated = has_generated_arrays(result);
+    shared.reset(new Value(Raw_xml_value::from_value(result)));
+    if (generated)
+      result = *shared;
+  }
+  catch (const std::exception& e)
+  {
+    impl_->fail(flight, -1, e.what());
+    throw;
+  }
+
+  impl_->finish(flight, *shared);
+}
+
+} // namespace iqxmlrpc
+
+// vim:ts=2:sw=2:et
@@ -0,0 +1,58 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+/*! \file */
+#ifndef _iqxmlrpc_coalescing_interceptor_h_
+#define _iqxmlrpc_coalescing_interceptor_h_
+
+#include "method.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#pragma warning(disable: 4275)
+#endif
+
+namespace iqxmlrpc {
+
+//! Interceptor which executes identical concurrent calls only once.
+/*! Call is identical to one in progress when it has the same method
+ *  name, parameters (see Value::equals()) and authenticated user.
+ *  Such calls wait for the first one to finish and share its result
+ *  or fault. Waiting calls still occupy executor's threads, but the
+ *  actual work is done once.
+ *
+ *  Only methods enabled with coalesce_method() are affected. Configure
+ *  them before the server starts. Streaming methods are never coalesced.
+ *
+ *  Push it before Memoizing_interceptor, so calls missing the cache
+ *  are coalesced.
+ */
+class LIBIQXMLRPC_API Coalescing_interceptor: public Interceptor {
+public:
+  Coalescing_interceptor();
+  ~Coalescing_interceptor();
+
+  //! Coalesce concurrent calls of specified method.
+  void coalesce_method(const std::string& name);
+
+  //! Number of calls which received result of another call.
+  size_t coalesced() const;
+
+  void process(Method*, const Param_list&, Value&);
+
+private:
+  class Impl;
+  boost::scoped_ptr<Impl> impl_;
+};
+
+} // namespace iqxmlrpc
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif
+// vim:ts=2:sw=2:et
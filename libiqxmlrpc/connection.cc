@@ -7,6 +7,86 @@
 using namespace iqnet;
 
 
+void Send_queue::push( const std::string& s )
+{
+  if( !s.empty() )
+    segments_.push_back( s );
+}
+
+
+void Send_queue::take( std::string& s )
+{
+  if( s.empty() )
+    return;
+
+  segments_.push_back( std::string() );
+  segments_.back().swap( s );
+}
+
+
+void Send_queue::clear()
+{
+  segments_.clear();
+  offset_ = 0;
+}
+
+
+void Send_queue::swap( Send_queue& other )
+{
+  segments_.swap( other.segments_ );
+  std::swap( offset_, other.offset_ );
+}
+
+
+Io_buffer Send_queue::front() const
+{
+  Io_buffer b = { 0, 0 };
+
+  if( !segments_.empty() )
+  {
+    b.data = segments_.front().data() + offset_;
+    b.size = segments_.front().size() - offset_;
+  }
+
+  return b;
+}
+
+
+size_t Send_queue::get_buffers( Io_buffer* bufs, size_t max ) const
+{
+  size_t n = 0;
+  std::deque<std::string>::const_iterator i = segments_.begin();
+
+  for( size_t off = offset_; n < max && i != segments_.end(); ++i, ++n, off = 0 )
+  {
+    bufs[n].data = i->data() + off;
+    bufs[n].size = i->size() - off;
+  }
+
+  return n;
+}
+
+
+void Send_queue::advance( size_t n )
+{
+  while( n && !segments_.empty() )
+  {
+    size_t left = segments_.front().size() - offset_;
+
+    if( n < left )
+    {
+      offset_ += n;
+      return;
+    }
+
+    n -= left;
+    offset_ = 0;
+    segments_.pop_front();
+  }
+}
+
+
+
 Connection::Connection( const Socket& s ):
   sock(s)
 {
@@ -31,6 +111,20 @@ size_t Connection::send( const char* data, size_t len )
 }
 
 
+size_t Connection::send( Send_queue& q )
+{
+  Io_buffer bufs[16];
+  size_t count = q.get_buffers( bufs, sizeof(bufs)/sizeof(bufs[0]) );
+
+  if( !count )
+    return 0;
+
+  size_t sz = sock.send( bufs, count );
+  q.advance( sz );
+  return sz;
+}
+
+
 size_t Connection::recv( char* buf, size_t len )
 {
   return sock.recv( buf, len );
@@ -8,11 +8,46 @@
 #include "net_except.h"
 #include "reactor.h"
 
+#include <deque>
 #include <string>
 
 namespace iqnet
 {
 
+//! Queue of data segments waiting to be sent.
+/*!
+    Segments are sent in order without being concatenated.
+    Partially sent segment is tracked with an offset, so
+    data is never erased from the front of a string.
+*/
+class LIBIQXMLRPC_API Send_queue {
+public:
+  Send_queue(): offset_(0) {}
+
+  //! Appends a copy of data.
+  void push( const std::string& );
+  //! Appends data by taking the string's content. The string becomes empty.
+  void take( std::string& );
+
+  bool empty() const { return segments_.empty(); }
+  void clear();
+  void swap( Send_queue& );
+
+  //! Returns unsent part of the first segment.
+  Io_buffer front() const;
+
+  //! Fills at most max buffers with unsent data.
+  //! Returns number of filled buffers.
+  size_t get_buffers( Io_buffer*, size_t max ) const;
+
+  //! Marks specified number of bytes as sent.
+  void advance( size_t );
+
+private:
+  std::deque<std::string> segments_;
+  size_t offset_;
+};
+
 //! An established TCP-connection.
 /*!
     A build block for connection handling.
@@ -42,6 +77,8 @@ public:
   }
 
   virtual size_t send( const char*, size_t );
+  //! Sends as much of queued data as possible and removes it from queue.
+  virtual size_t send( Send_queue& );
   virtual size_t recv( char*, size_t );
 };
 
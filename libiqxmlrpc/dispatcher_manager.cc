@@ -30,6 +30,9 @@ private:
 
   virtual void
   do_get_methods_list(Array&) const;
+
+  virtual bool
+  do_get_method_signature(const std::string&, Array&) const;
 };
 
 Default_method_dispatcher::~Default_method_dispatcher()
@@ -60,6 +63,18 @@ void Default_method_dispatcher::do_get_methods_list(Array& retval) const
   }
 }
 
+bool Default_method_dispatcher::do_get_method_signature(
+  const std::string& name, Array& retval) const
+{
+  Factory_map::const_iterator i = fs.find(name);
+  Array sig;
+  if (i == fs.end() || !i->second->signature(sig))
+    return false;
+
+  retval.push_back(sig);
+  return true;
+}
+
 //
 // System method factory
 //
@@ -145,10 +160,25 @@ void Method_dispatcher_manager::get_methods_list(Array& retval) const
     (*i)->get_methods_list(retval);
 }
 
+bool Method_dispatcher_manager::get_method_signature(
+  const std::string& name, Array& retval) const
+{
+  typedef Impl::DispatchersSet::const_iterator CI;
+  for (CI i = impl_->dispatchers.begin(); i != impl_->dispatchers.end(); ++i)
+  {
+    if ((*i)->get_method_signature(name, retval))
+      return true;
+  }
+
+  return false;
+}
+
 void Method_dispatcher_manager::enable_introspection()
 {
   impl_->default_disp->register_method("system.listMethods",
     new System_method_factory<builtins::List_methods>(this));
+  impl_->default_disp->register_method("system.methodSignature",
+    new System_method_factory<builtins::Method_signature>(this));
 }
 
 } // namespace iqxmlrpc
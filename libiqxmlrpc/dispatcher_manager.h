@@ -43,6 +43,9 @@ public:
   //! Return list of methods provided by all registered dispatchers.
   void get_methods_list(Array&) const;
 
+  //! Get signatures of the method from the first dispatcher which knows them.
+  bool get_method_signature(const std::string& name, Array&) const;
+
   //! Turns on introspection.
   void enable_introspection();
 };
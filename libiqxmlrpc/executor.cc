@@ -6,6 +6,7 @@
 #include "reactor_impl.h"
 #include "response.h"
 #include "server.h"
+#include "server_conn.h"
 #include "util.h"
 
 #include <memory>
@@ -39,6 +40,14 @@ void Executor::interrupt_server()
   server->interrupt();
 }
 
+// ----------------------------------------------------------------------------
+void Executor_factory_base::schedule_response_chunk(
+  Server*, Server_connection* conn )
+{
+  conn->produce_response_chunk();
+}
+
+
 // ----------------------------------------------------------------------------
 void Serial_executor::execute( const Param_list& params )
 {
@@ -97,17 +106,29 @@ void Pool_executor_factory::Pool_thread::operator ()()
   {
     scoped_lock lk(pool->req_queue_lock);
 
-    if (pool->req_queue.empty())
+    if (pool->req_queue.empty() && pool->chunk_queue.empty())
     {
       pool->req_queue_cond.wait(lk);
 
       if (pool->is_being_destructed())
         return;
 
-      if (pool->req_queue.empty())
+      if (pool->req_queue.empty() && pool->chunk_queue.empty())
         continue;
     }
 
+    // Responses in progress go first, they already hold connections.
+    if (!pool->chunk_queue.empty())
+    {
+      Chunk_job job = pool->chunk_queue.front();
+      pool->chunk_queue.pop_front();
+      lk.unlock();
+
+      job.second->produce_response_chunk();
+      job.first->interrupt();
+      continue;
+    }
+
     Pool_executor* executor = pool->req_queue.front();
     pool->req_queue.pop_front();
     lk.unlock();
@@ -160,6 +181,15 @@ void Pool_executor_factory::add_threads( unsigned num )
 }
 
 
+void Pool_executor_factory::schedule_response_chunk(
+  Server* s, Server_connection* c )
+{
+  scoped_lock lk(req_queue_lock);
+  chunk_queue.push_back(Chunk_job(s, c));
+  req_queue_cond.notify_one();
+}
+
+
 void Pool_executor_factory::register_executor( Pool_executor* executor )
 {
   scoped_lock lk(req_queue_lock);
@@ -203,6 +233,8 @@ Pool_executor::~Pool_executor()
 
 void Pool_executor::execute( const Param_list& params_ )
 {
+  // The copy shares request's arena, if any.
+  Value_arena::Scope scope(arena.get());
   params = params_;
   pool->register_executor( this );
 }
@@ -219,6 +251,11 @@ void Pool_executor::process_actual_execution()
   {
     schedule_response( Response( f.code(), f.what() ) );
   }
+  catch( const iqxmlrpc::Exception& e )
+  {
+    // Keep library's fault codes as the serial executor does.
+    schedule_response( Response( e.code(), e.what() ) );
+  }
   catch( const std::exception& e )
   {
     schedule_response( Response( -1, e.what() ) );
@@ -6,6 +6,7 @@
 
 #include "lock.h"
 #include "method.h"
+#include "value_arena.h"
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -15,12 +16,14 @@
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/condition.hpp>
+#include <boost/shared_ptr.hpp>
 
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
 
 #include <deque>
+#include <utility>
 #include <vector>
 
 namespace iqnet
@@ -54,6 +57,7 @@ class LIBIQXMLRPC_API Executor {
 protected:
   Method* method;
   Interceptor* interceptors;
+  boost::shared_ptr<Value_arena> arena;
 
 private:
   Server* server;
@@ -65,6 +69,9 @@ public:
 
   void set_interceptors(Interceptor* ic) { interceptors = ic; }
 
+  //! Keep arena that holds request's parameters until execution ends.
+  void set_arena(const boost::shared_ptr<Value_arena>& a) { arena = a; }
+
   //! Start method execution.
   virtual void execute( const Param_list& params ) = 0;
 
@@ -86,6 +93,13 @@ public:
   ) = 0;
 
   virtual iqnet::Reactor_base* create_reactor() = 0;
+
+  //! Produce next part of connection's streamed response.
+  /*! Parts are generated by user's code (e.g. Generated_array),
+   *  so factories with threads do it outside of reactor's thread.
+   *  Default implementation produces the part in place.
+   */
+  virtual void schedule_response_chunk( Server*, Server_connection* );
 };
 
 
@@ -132,8 +146,11 @@ class LIBIQXMLRPC_API Pool_executor_factory: public Executor_factory_base {
   boost::thread_group       threads;
   std::vector<Pool_thread*> pool;
 
+  typedef std::pair<Server*, Server_connection*> Chunk_job;
+
   // Objects Pool_thread works with
   std::deque<Pool_executor*> req_queue;
+  std::deque<Chunk_job>      chunk_queue;
   boost::mutex               req_queue_lock;
   boost::condition           req_queue_cond;
 
@@ -146,6 +163,7 @@ public:
 
   Executor* create( Method* m, Server* s, Server_connection* c );
   iqnet::Reactor_base* create_reactor();
+  void schedule_response_chunk( Server*, Server_connection* );
 
   //! Add some threads to the pool.
   void add_threads(unsigned num);
@@ -3,6 +3,7 @@
 
 #include "sysinc.h"
 
+#include "connection.h"
 #include "http_errors.h"
 #include "method.h"
 #include "version.h"
@@ -32,6 +33,7 @@ namespace names {
   const char date[]           = "date";
   const char authorization[]  = "authorization";
   const char expect_continue[]= "expect";
+  const char transfer_encoding[] = "transfer-encoding";
 } // namespace names
 
 
@@ -205,6 +207,13 @@ void Header::set_content_length(size_t len)
     set_option(names::content_type, "text/xml");
 }
 
+void Header::set_chunked()
+{
+  options_.erase(names::content_length);
+  set_option(names::transfer_encoding, "chunked");
+  set_option(names::content_type, "text/xml");
+}
+
 void Header::set_conn_keep_alive(bool c)
 {
   set_option(names::connection, c ? "keep-alive" : "close");
@@ -228,6 +237,16 @@ bool Header::expect_continue() const
   return option_exists(names::expect_continue);
 }
 
+bool Header::chunked() const
+{
+  if (!option_exists(names::transfer_encoding))
+    return false;
+
+  std::string te = get_string(names::transfer_encoding);
+  boost::to_lower(te);
+  return boost::find_first(te, "chunked");
+}
+
 // ----------------------------------------------------------------------------
 Request_header::Request_header(Verification_level lev, const std::string& to_parse):
   Header(lev)
@@ -249,6 +268,8 @@ Request_header::Request_header(Verification_level lev, const std::string& to_par
 
   if (method_line.size() > 1)
     uri_ = method_line[1];
+
+  version_ = method_line.size() > 2 ? method_line[2] : "HTTP/1.0";
 }
 
 Request_header::Request_header(
@@ -256,7 +277,8 @@ Request_header::Request_header(
   const std::string& vhost,
   int port
 ):
-  uri_(req_uri)
+  uri_(req_uri),
+  version_("HTTP/1.1")
 {
   std::ostringstream host_opt;
   host_opt << vhost << ":" << port;
@@ -266,7 +288,7 @@ Request_header::Request_header(
 
 std::string Request_header::dump_head() const
 {
-  return "POST " + uri() + " HTTP/1.0" + names::crlf;
+  return "POST " + uri() + " " + version() + names::crlf;
 }
 
 std::string Request_header::host() const
@@ -388,10 +410,10 @@ std::string Response_header::server() const
 }
 
 // ---------------------------------------------------------------------------
-Packet::Packet( Header* h, const std::string& co ):
-  header_(h),
-  content_(co)
+Packet::Packet( Header* h, std::string co ):
+  header_(h)
 {
+  content_.swap(co);
   header_->set_content_length(content_.length());
 }
 
@@ -399,6 +421,37 @@ Packet::~Packet()
 {
 }
 
+void Packet::dump( iqnet::Send_queue& q )
+{
+  std::string h( header_->dump() );
+  q.take( h );
+
+  if( header_->chunked() && !content_.empty() )
+    dump_chunk( q, content_ );
+  else
+    q.take( content_ );
+}
+
+void dump_chunk( iqnet::Send_queue& q, std::string& data )
+{
+  std::ostringstream size_line;
+  size_line << std::hex << data.size() << names::crlf;
+
+  q.push( size_line.str() );
+  q.take( data );
+  q.push( names::crlf );
+}
+
+void Packet::set_chunked()
+{
+  header_->set_chunked();
+}
+
+void Packet::set_content_length( size_t len )
+{
+  header_->set_content_length( len );
+}
+
 void Packet::set_keep_alive( bool keep_alive )
 {
   header_->set_conn_keep_alive( keep_alive );
@@ -410,6 +463,8 @@ void Packet_reader::clear()
   header = 0;
   content_cache.erase();
   header_cache.erase();
+  chunked_content.erase();
+  chunk_pos = 0;
   constructed = false;
   total_sz = 0;
 }
@@ -419,7 +474,7 @@ void Packet_reader::check_sz( size_t sz )
   if( !pkt_max_sz )
     return;
 
-  if (header) {
+  if (header && !header->chunked()) {
     if (header->content_length() + header_cache.length() >= pkt_max_sz)
       throw Request_too_large();
   }
@@ -449,6 +504,93 @@ bool Packet_reader::read_header( const std::string& s )
   return true;
 }
 
+namespace {
+
+bool parse_chunk_size(const std::string& s, size_t begin, size_t end, size_t& sz)
+{
+  // Chunk extensions are ignored.
+  size_t ext = s.find(';', begin);
+  if (ext < end)
+    end = ext;
+
+  while (end > begin && (s[end - 1] == ' ' || s[end - 1] == '\t'))
+    --end;
+
+  if (begin == end || end - begin > sizeof(size_t) * 2)
+    return false;
+
+  sz = 0;
+  for (size_t i = begin; i < end; ++i) {
+    char c = s[i];
+    unsigned d;
+
+    if (c >= '0' && c <= '9')
+      d = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      d = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      d = c - 'A' + 10;
+    else
+      return false;
+
+    sz = sz * 16 + d;
+  }
+
+  return true;
+}
+
+} // anonymous namespace
+
+//! Decodes chunks received so far into chunked_content.
+//! Returns true when the last chunk and trailer are received.
+bool Packet_reader::read_chunks()
+{
+  bool last = false;
+
+  for (;;) {
+    size_t eol = content_cache.find(names::crlf, chunk_pos);
+    if (eol == std::string::npos)
+      break;
+
+    size_t sz = 0;
+    if (!parse_chunk_size(content_cache, chunk_pos, eol, sz))
+      throw Malformed_packet("bad chunk size");
+
+    if (!sz) {
+      // Skip trailer up to empty line.
+      size_t p = eol + 2;
+      size_t e = content_cache.find(names::crlf, p);
+
+      for (; e != std::string::npos && e != p; e = content_cache.find(names::crlf, p))
+        p = e + 2;
+
+      if (e == std::string::npos)
+        break;
+
+      last = true;
+      break;
+    }
+
+    size_t data = eol + 2;
+    if (content_cache.length() - data < sz + 2)
+      break;
+
+    if (content_cache.compare(data + sz, 2, names::crlf) != 0)
+      throw Malformed_packet("chunk is not terminated with CRLF");
+
+    chunked_content.append(content_cache, data, sz);
+    chunk_pos = data + sz + 2;
+  }
+
+  // Drop decoded chunks.
+  if (chunk_pos) {
+    content_cache.erase(0, chunk_pos);
+    chunk_pos = 0;
+  }
+
+  return last;
+}
+
 template <class Header_type>
 Packet* Packet_reader::read_packet( const std::string& s, bool hdr_only )
 {
@@ -476,6 +618,16 @@ Packet* Packet_reader::read_packet( const std::string& s, bool hdr_only )
       return new Packet( header, std::string() );
     }
 
+    if ( header->chunked() )
+    {
+      if ( !read_chunks() )
+        return 0;
+
+      Packet* packet = new Packet( header, chunked_content );
+      constructed = true;
+      return packet;
+    }
+
     bool ready = (header->content_length() == 0 && s.empty()) ||
                  content_cache.length() >= header->content_length();
 
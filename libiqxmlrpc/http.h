@@ -14,6 +14,10 @@
 #include <map>
 #include <string>
 
+namespace iqnet {
+class Send_queue;
+}
+
 namespace iqxmlrpc {
 
 class Auth_Plugin_base;
@@ -43,8 +47,12 @@ public:
   unsigned  content_length()  const;
   bool      conn_keep_alive() const;
   bool      expect_continue() const;
+  //! Whether the body uses chunked transfer encoding.
+  bool      chunked()         const;
 
   void set_content_length( size_t ln );
+  //! Announce body sent in chunks instead of content length.
+  void set_chunked();
   void set_conn_keep_alive( bool );
   void set_option(const std::string& name, const std::string& value);
 
@@ -106,12 +114,15 @@ private:
 //! HTTP request's header.
 class LIBIQXMLRPC_API Request_header: public Header {
   std::string uri_;
+  std::string version_;
 
 public:
   Request_header( Verification_level, const std::string& to_parse );
   Request_header( const std::string& uri, const std::string& vhost, int port );
 
   const std::string& uri() const { return uri_; }
+  //! Protocol version of request line, e.g. "HTTP/1.1".
+  const std::string& version() const { return version_; }
   std::string host()  const;
   std::string agent() const;
 
@@ -153,7 +164,8 @@ protected:
   std::string content_;
 
 public:
-  Packet( http::Header* header, const std::string& content );
+  //! Content is taken by value and swapped in, so temporary is not copied.
+  Packet( http::Header* header, std::string content );
   virtual ~Packet();
 
   //! Sets header option "connection: {keep-alive|close}".
@@ -163,10 +175,22 @@ public:
   const http::Header* header()  const { return header_.get(); }
   const std::string&  content() const { return content_; }
 
+  //! Switch packet to chunked transfer encoding.
+  //! Content is sent as the first chunk, the rest ones are up to caller.
+  void set_chunked();
+
+  //! Announce length of the whole body when content is only its beginning.
+  //! The rest of body is up to caller.
+  void set_content_length( size_t );
+
   std::string dump() const
   {
     return header_->dump() + content_;
   }
+
+  //! Puts header and content into queue as separate segments.
+  //! Content is moved, so packet's content becomes empty.
+  void dump( iqnet::Send_queue& );
 };
 
 #ifdef _MSC_VER
@@ -174,11 +198,17 @@ public:
 #pragma warning(disable: 4251)
 #endif
 
+//! Puts data into queue as a chunk of chunked transfer encoding.
+//! Data is moved. Empty data makes the last chunk.
+LIBIQXMLRPC_API void dump_chunk( iqnet::Send_queue&, std::string& );
+
 //! Helper that responsible for constructing HTTP packets of specified type
 //! (request or response).
 class Packet_reader {
   std::string header_cache;
   std::string content_cache;
+  std::string chunked_content;
+  size_t chunk_pos;
   Header* header;
   Verification_level ver_level_;
   bool constructed;
@@ -188,6 +218,7 @@ class Packet_reader {
 
 public:
   Packet_reader():
+    chunk_pos(0),
     header(0),
     ver_level_(HTTP_CHECK_WEAK),
     constructed(false),
@@ -222,6 +253,7 @@ private:
   void clear();
   void check_sz( size_t );
   bool read_header( const std::string& );
+  bool read_chunks();
 
   template <class Header_type>
   Packet* read_packet( const std::string&, bool = false );
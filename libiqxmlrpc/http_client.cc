@@ -22,9 +22,10 @@ Http_client_connection::Http_client_connection( const iqnet::Socket& s, bool nb
 }
 
 
-http::Packet* Http_client_connection::do_process_session( const std::string& s )
+http::Packet* Http_client_connection::do_process_session( iqnet::Send_queue& q )
 {
-  out_str = s;
+  out_queue.clear();
+  out_queue.swap( q );
   resp_packet = 0;
   reactor->register_handler( this, Reactor_base::OUTPUT );
 
@@ -41,10 +42,9 @@ http::Packet* Http_client_connection::do_process_session( const std::string& s )
 
 void Http_client_connection::handle_output( bool& )
 {
-  size_t sz = send( out_str.c_str(), out_str.length() );
-  out_str.erase( 0, sz );
+  send( out_queue );
 
-  if( out_str.empty() )
+  if( out_queue.empty() )
   {
     reactor->unregister_handler( this, Reactor_base::OUTPUT );
     reactor->register_handler( this, Reactor_base::INPUT );
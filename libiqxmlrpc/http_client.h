@@ -20,7 +20,7 @@ class LIBIQXMLRPC_API Http_client_connection:
   public iqnet::Connection
 {
   std::auto_ptr<iqnet::Reactor_base> reactor;
-  std::string out_str;
+  iqnet::Send_queue out_queue;
   http::Packet* resp_packet;
 
 public:
@@ -32,7 +32,7 @@ public:
   void handle_output( bool& );
 
 protected:
-  http::Packet* do_process_session( const std::string& );
+  http::Packet* do_process_session( iqnet::Send_queue& );
 };
 
 //! XML-RPC \b HTTP PROXY client connection.
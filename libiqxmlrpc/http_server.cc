@@ -105,22 +105,27 @@ void Http_server_connection::handle_input( bool& terminate )
 
 void Http_server_connection::handle_output( bool& terminate )
 {
-  size_t sz = send( response.c_str(), response.length() );
+  send( response );
 
-  if( sz == response.length() )
-  {
-    if( keep_alive )
-    {
-      reactor->unregister_handler( this, Reactor_base::OUTPUT );
-      reactor->register_handler( this, Reactor_base::INPUT );
-    }
-    else
-      terminate = true;
+  if( !response.empty() )
+    return;
 
+  if( response_pending() )
+  {
+    // Next part is produced out of reactor's thread, which
+    // registers the connection again when the part is ready.
+    reactor->unregister_handler( this, Reactor_base::OUTPUT );
+    server->schedule_response_chunk( this );
     return;
   }
 
-  response.erase( 0, sz );
+  if( keep_alive )
+  {
+    reactor->unregister_handler( this, Reactor_base::OUTPUT );
+    reactor->register_handler( this, Reactor_base::INPUT );
+  }
+  else
+    terminate = true;
 }
 
 
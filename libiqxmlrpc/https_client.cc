@@ -51,7 +51,7 @@ Https_proxy_client_connection::Https_proxy_client_connection(
   sock.set_non_blocking( nb );
 }
 
-http::Packet* Https_proxy_client_connection::do_process_session( const std::string& s )
+http::Packet* Https_proxy_client_connection::do_process_session( iqnet::Send_queue& s )
 {
   setup_tunnel();
 
@@ -66,7 +66,8 @@ void Https_proxy_client_connection::setup_tunnel()
   reactor->register_handler( this, Reactor_base::OUTPUT );
 
   Proxy_request_header h(opts().addr());
-  out_str = h.dump();
+  std::string hdr( h.dump() );
+  out_queue.take( hdr );
 
   do {
     int to = opts().timeout() >= 0 ? opts().timeout() * 1000 : -1;
@@ -84,10 +85,9 @@ void Https_proxy_client_connection::setup_tunnel()
 
 void Https_proxy_client_connection::handle_output( bool& )
 {
-  size_t sz = send( out_str.c_str(), out_str.length() );
-  out_str.erase( 0, sz );
+  send( out_queue );
 
-  if( out_str.empty() )
+  if( out_queue.empty() )
   {
     reactor->unregister_handler( this, Reactor_base::OUTPUT );
     reactor->register_handler( this, Reactor_base::INPUT );
@@ -127,13 +127,15 @@ Https_client_connection::Https_client_connection( const iqnet::Socket& s, bool n
 
 inline void Https_client_connection::reg_send_request()
 {
-  reg_send( out_str.c_str(), out_str.length() );
+  Io_buffer b = out_queue.front();
+  reg_send( b.data, b.size );
 }
 
 
-http::Packet* Https_client_connection::do_process_session( const std::string& s )
+http::Packet* Https_client_connection::do_process_session( iqnet::Send_queue& q )
 {
-  out_str = s;
+  out_queue.clear();
+  out_queue.swap( q );
   resp_packet = 0;
 
   if( established )
@@ -159,6 +161,14 @@ void Https_client_connection::connect_succeed()
 
 void Https_client_connection::send_succeed( bool& )
 {
+  out_queue.advance( out_queue.front().size );
+
+  if( !out_queue.empty() )
+  {
+    reg_send_request();
+    return;
+  }
+
   reg_recv( read_buf(), read_buf_sz() );
 }
 
@@ -28,14 +28,14 @@ public:
   void handle_output( bool& );
 
 protected:
-  http::Packet* do_process_session( const std::string& );
+  http::Packet* do_process_session( iqnet::Send_queue& );
 
   void setup_tunnel();
 
   boost::scoped_ptr<iqnet::Reactor_base> reactor;
   boost::scoped_ptr<http::Packet> resp_packet;
   bool non_blocking;
-  std::string out_str;
+  iqnet::Send_queue out_queue;
 };
 
 //! XML-RPC \b HTTPS client's connection.
@@ -45,7 +45,7 @@ class LIBIQXMLRPC_API Https_client_connection:
 {
   std::auto_ptr<iqnet::Reactor_base> reactor;
   http::Packet* resp_packet;
-  std::string out_str;
+  iqnet::Send_queue out_queue;
   bool established;
 
 public:
@@ -65,7 +65,7 @@ public:
 
 protected:
   friend class Https_proxy_client_connection;
-  http::Packet* do_process_session( const std::string& );
+  http::Packet* do_process_session( iqnet::Send_queue& );
 
 private:
   void reg_send_request();
@@ -99,7 +99,21 @@ void Https_server_connection::recv_succeed( bool&, size_t, size_t real_len )
 
 void Https_server_connection::send_succeed( bool& terminate )
 {
-  response = std::string();
+  response.advance( response.front().size );
+
+  if( response.empty() && response_pending() )
+  {
+    // Next part is produced out of reactor's thread,
+    // which registers sending when the part is ready.
+    server->schedule_response_chunk( this );
+    return;
+  }
+
+  if( !response.empty() )
+  {
+    do_schedule_response();
+    return;
+  }
 
   if( keep_alive )
     my_reg_recv();
@@ -114,7 +128,19 @@ void Https_server_connection::send_succeed( bool& terminate )
 
 void Https_server_connection::do_schedule_response()
 {
-  reg_send( response.data(), response.length() );
+  // Streamed response may end with an empty part.
+  if( response.empty() )
+  {
+    if( keep_alive )
+      my_reg_recv();
+    else
+      reg_shutdown();
+
+    return;
+  }
+
+  Io_buffer b = response.front();
+  reg_send( b.data, b.size );
 }
 
 #ifdef _MSC_VER
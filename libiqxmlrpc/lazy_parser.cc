@@ -0,0 +1,711 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <libxml/encoding.h>
+#include <libxml/tree.h>
+#include <boost/optional.hpp>
+#include "except.h"
+#include "lazy_parser.h"
+#include "value_parser.h"
+
+namespace iqxmlrpc {
+
+namespace {
+
+//! Tag found by Scanner.
+struct Tag {
+  enum Kind {
+    START,
+    END,
+    EMPTY
+  };
+
+  Kind kind;
+  size_t name_begin;
+  size_t name_len;
+  size_t begin;   // position of '<'
+  size_t end;     // position after '>'
+};
+
+//! Minimal XML scanner that finds element boundaries.
+/*! Document is checked once by well_formed(), other methods
+ *  rely on it and only check what XML-RPC requires.
+ */
+class Scanner {
+public:
+  Scanner(const std::string& s):
+    s_(s) {}
+
+  //! Check whole document for balanced tags and valid references.
+  /*! Returns false for documents that regular parser has to handle:
+   *  malformed ones and those with DTD, comments, CDATA sections or
+   *  processing instructions within the root element, which libxml2
+   *  reports as separate nodes.
+   */
+  bool
+  well_formed() const
+  {
+    try {
+      return check_document();
+    }
+    catch (const XML_RPC_violation&) {
+      return false;
+    }
+  }
+
+  //! Find next tag at or after pos.
+  //! Text, comments, CDATA, PIs and DTD are skipped.
+  bool
+  next_tag(size_t pos, Tag& t) const
+  {
+    for (;;) {
+      size_t lt = s_.find('<', pos);
+      if (lt == std::string::npos)
+        return false;
+
+      if (starts_with(lt, "<!--")) {
+        pos = find("-->", lt + 4) + 3;
+      } else if (starts_with(lt, "<![CDATA[")) {
+        pos = find("]]>", lt + 9) + 3;
+      } else if (starts_with(lt, "<?")) {
+        pos = find("?>", lt + 2) + 2;
+      } else if (starts_with(lt, "<!")) {
+        pos = skip_declaration(lt);
+      } else {
+        read_tag(lt, t);
+        return true;
+      }
+    }
+  }
+
+  //! Get next tag which must exist.
+  Tag
+  next_tag(size_t pos) const
+  {
+    Tag t;
+    if (!next_tag(pos, t))
+      throw XML_RPC_violation("unexpected end of document");
+
+    return t;
+  }
+
+  //! Returns end tag matching specified start tag.
+  Tag
+  skip_element(const Tag& start) const
+  {
+    int depth = 1;
+    Tag t = start;
+
+    while (depth) {
+      t = next_tag(t.end);
+
+      if (t.kind == Tag::START)
+        ++depth;
+      else if (t.kind == Tag::END)
+        --depth;
+    }
+
+    if (!same_name(t, start))
+      throw XML_RPC_violation("unexpected tag </" + name(t) + ">");
+
+    return t;
+  }
+
+  //! Returns position after specified element.
+  size_t
+  element_end(const Tag& start) const
+  {
+    return start.kind == Tag::EMPTY ? start.end : skip_element(start).end;
+  }
+
+  bool
+  is(const Tag& t, const char* tag_name) const
+  {
+    return t.name_len == strlen(tag_name) &&
+      !s_.compare(t.name_begin, t.name_len, tag_name);
+  }
+
+  bool
+  same_name(const Tag& a, const Tag& b) const
+  {
+    return a.name_len == b.name_len &&
+      !s_.compare(a.name_begin, a.name_len, s_, b.name_begin, b.name_len);
+  }
+
+  std::string
+  name(const Tag& t) const
+  {
+    return s_.substr(t.name_begin, t.name_len);
+  }
+
+  //! Returns decoded text between two positions.
+  std::string
+  text(size_t begin, size_t end) const
+  {
+    std::string retval;
+    scan_text(begin, end, &retval);
+    return retval;
+  }
+
+  //! Whether there are only white spaces between two positions.
+  bool
+  blank(size_t begin, size_t end) const
+  {
+    for (size_t i = begin; i < end; ++i) {
+      if (!is_space(s_[i]))
+        return false;
+    }
+
+    return true;
+  }
+
+private:
+  bool
+  check_document() const
+  {
+    std::vector<Tag> open;
+    bool root_closed = false;
+    size_t pos = 0;
+
+    for (;;) {
+      size_t lt = s_.find('<', pos);
+      size_t end = lt == std::string::npos ? s_.size() : lt;
+
+      if (open.empty()) {
+        if (!blank(pos, end))
+          return false;
+      } else {
+        scan_text(pos, end, 0);
+      }
+
+      if (lt == std::string::npos)
+        break;
+
+      if (starts_with(lt, "<?") && open.empty()) {
+        pos = find("?>", lt + 2) + 2;
+      } else if (starts_with(lt, "<!--") && open.empty()) {
+        pos = find("-->", lt + 4) + 3;
+      } else if (starts_with(lt, "<?") || starts_with(lt, "<!")) {
+        return false;
+      } else {
+        Tag t;
+        read_tag(lt, t);
+        pos = t.end;
+
+        if (t.kind == Tag::END) {
+          if (open.empty() || !same_name(open.back(), t))
+            return false;
+
+          open.pop_back();
+          root_closed = open.empty();
+        } else if (root_closed) {
+          return false;
+        } else if (t.kind == Tag::START) {
+          open.push_back(t);
+        } else {
+          root_closed = open.empty();
+        }
+      }
+    }
+
+    return root_closed;
+  }
+
+  //! Decodes text between two positions if out is set, validates it otherwise.
+  /*! Text is expected to contain no markup (see well_formed()).
+   *  Line breaks are normalized as XML requires.
+   */
+  void
+  scan_text(size_t begin, size_t end, std::string* out) const
+  {
+    for (size_t i = begin; i < end;) {
+      if (s_[i] == '&') {
+        i = decode_reference(i, end, out);
+      } else if (s_[i] == '<') {
+        throw XML_RPC_violation("text is expected");
+      } else if (s_[i] == '\r') {
+        if (out)
+          *out += '\n';
+        i += i + 1 < end && s_[i + 1] == '\n' ? 2 : 1;
+      } else {
+        size_t e = std::min(s_.find_first_of("&<\r", i), end);
+        if (out)
+          out->append(s_, i, e - i);
+        i = e;
+      }
+    }
+  }
+
+  bool
+  starts_with(size_t pos, const char* prefix) const
+  {
+    return !s_.compare(pos, strlen(prefix), prefix);
+  }
+
+  size_t
+  find(const char* what, size_t pos) const
+  {
+    size_t r = s_.find(what, pos);
+    if (r == std::string::npos)
+      throw XML_RPC_violation("unexpected end of document");
+
+    return r;
+  }
+
+  static bool
+  is_space(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  void
+  read_tag(size_t lt, Tag& t) const
+  {
+    size_t i = lt + 1;
+    size_t n = s_.size();
+    bool is_end = i < n && s_[i] == '/';
+    if (is_end)
+      ++i;
+
+    size_t nb = i;
+    for (; i < n && !is_space(s_[i]) && s_[i] != '>' && s_[i] != '/'; ++i) {
+      if (s_[i] == ':')
+        nb = i + 1; // ignore namespace prefix
+    }
+
+    t.name_begin = nb;
+    t.name_len = i - nb;
+
+    for (char quote = 0; i < n; ++i) {
+      char c = s_[i];
+      if (quote) {
+        if (c == quote)
+          quote = 0;
+      } else if (c == '"' || c == '\'') {
+        quote = c;
+      } else if (c == '>') {
+        break;
+      }
+    }
+
+    if (i >= n || !t.name_len)
+      throw XML_RPC_violation("malformed tag");
+
+    t.kind = is_end ? Tag::END : (s_[i - 1] == '/' ? Tag::EMPTY : Tag::START);
+    t.begin = lt;
+    t.end = i + 1;
+  }
+
+  //! Skip <!DOCTYPE ...> including its internal subset.
+  size_t
+  skip_declaration(size_t lt) const
+  {
+    int brackets = 0;
+    for (size_t i = lt + 2; i < s_.size(); ++i) {
+      switch (s_[i]) {
+      case '[': ++brackets; break;
+      case ']': --brackets; break;
+      case '>':
+        if (!brackets)
+          return i + 1;
+        break;
+      }
+    }
+
+    throw XML_RPC_violation("unexpected end of document");
+  }
+
+  size_t
+  decode_reference(size_t amp, size_t end, std::string* out) const
+  {
+    size_t semi = s_.find(';', amp);
+    if (semi == std::string::npos || semi >= end)
+      throw XML_RPC_violation("malformed entity reference");
+
+    std::string ref(s_, amp + 1, semi - amp - 1);
+    char c = 0;
+
+    if (ref == "lt")
+      c = '<';
+    else if (ref == "gt")
+      c = '>';
+    else if (ref == "amp")
+      c = '&';
+    else if (ref == "quot")
+      c = '"';
+    else if (ref == "apos")
+      c = '\'';
+    else if (ref.size() <= 1 || ref[0] != '#')
+      throw XML_RPC_violation("unknown entity &" + ref + ";");
+
+    if (!c) {
+      unsigned long code = char_ref(ref);
+      if (out)
+        append_utf8(code, *out);
+    } else if (out) {
+      *out += c;
+    }
+
+    return semi + 1;
+  }
+
+  static unsigned long
+  char_ref(const std::string& ref)
+  {
+    bool hex = ref[1] == 'x';
+    const char* digits = ref.c_str() + (hex ? 2 : 1);
+    char* e = 0;
+    unsigned long code = strtoul(digits, &e, hex ? 16 : 10);
+
+    if (!*digits || *e || !code || code > 0x10FFFF)
+      throw XML_RPC_violation("malformed character reference");
+
+    return code;
+  }
+
+  static void
+  append_utf8(unsigned long c, std::string& out)
+  {
+    if (c < 0x80) {
+      out += static_cast<char>(c);
+    } else if (c < 0x800) {
+      out += static_cast<char>(0xC0 | (c >> 6));
+      out += static_cast<char>(0x80 | (c & 0x3F));
+    } else if (c < 0x10000) {
+      out += static_cast<char>(0xE0 | (c >> 12));
+      out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (c & 0x3F));
+    } else {
+      out += static_cast<char>(0xF0 | (c >> 18));
+      out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+      out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (c & 0x3F));
+    }
+  }
+
+  const std::string& s_;
+};
+
+} // anonymous namespace
+
+//
+// Lazy_array_data
+//
+
+Lazy_array_data*
+Lazy_array_data::clone() const
+{
+  Lazy_array_data* retval = new Lazy_array_data(buf_);
+  retval->ranges_ = ranges_;
+  return retval;
+}
+
+Value*
+Lazy_array_data::decode(size_t idx) const
+{
+  return new Value(Lazy_parser(buf_).build_value(ranges_.at(idx)));
+}
+
+//
+// Lazy_struct_data
+//
+
+Lazy_struct_data*
+Lazy_struct_data::clone() const
+{
+  Lazy_struct_data* retval = new Lazy_struct_data(buf_);
+  retval->ranges_ = ranges_;
+  return retval;
+}
+
+Value*
+Lazy_struct_data::decode(const std::string& name) const
+{
+  std::map<std::string, Lazy_range>::const_iterator i = ranges_.find(name);
+  if (i == ranges_.end())
+    throw Struct::No_field(name);
+
+  return new Value(Lazy_parser(buf_).build_value(i->second));
+}
+
+//
+// Lazy_parser
+//
+
+Lazy_parser::Lazy_parser(const boost::shared_ptr<const std::string>& buf):
+  buf_(buf)
+{
+}
+
+bool
+Lazy_parser::find_response_value(Lazy_range& range) const
+{
+  static const char* path[] = { "methodResponse", "params", "param", "value" };
+  static const size_t depth = sizeof(path)/sizeof(path[0]);
+
+  Scanner sc(*buf_);
+  if (!sc.well_formed())
+    return false;
+
+  Tag t;
+  t.end = 0;
+
+  for (size_t i = 0; i < depth; ++i) {
+    if (!sc.next_tag(t.end, t) || t.kind == Tag::END || !sc.is(t, path[i]))
+      return false;
+
+    if (t.kind == Tag::EMPTY && i + 1 < depth)
+      return false;
+  }
+
+  range = Lazy_range(t.begin, sc.element_end(t));
+
+  // The value must be the only content of the response.
+  Tag c;
+  c.end = range.second;
+  for (size_t i = depth - 1; i > 0; --i) {
+    if (!sc.next_tag(c.end, c) || c.kind != Tag::END || !sc.is(c, path[i - 1]))
+      return false;
+  }
+
+  return true;
+}
+
+Value_type*
+Lazy_parser::build_value(const Lazy_range& range) const
+{
+  Scanner sc(*buf_);
+  Tag t = sc.next_tag(range.first);
+
+  if (t.kind == Tag::EMPTY)
+    return new String("");
+
+  Tag c = sc.next_tag(t.end);
+  if (c.kind != Tag::END) {
+    if (sc.is(c, "array"))
+      return build_array(c.end, c.kind == Tag::EMPTY);
+
+    if (sc.is(c, "struct"))
+      return build_struct(c.end, c.kind == Tag::EMPTY);
+  }
+
+  return build_scalar(t.end);
+}
+
+Value_type*
+Lazy_parser::build_array(size_t pos, bool empty) const
+{
+  std::auto_ptr<Array> retval(new Array);
+  if (empty)
+    return retval.release();
+
+  Scanner sc(*buf_);
+  Tag t = sc.next_tag(pos);
+  if (t.kind == Tag::END)
+    return retval.release();
+
+  if (!sc.is(t, "data"))
+    throw XML_RPC_violation("unexpected tag <" + sc.name(t) + "> in array");
+
+  if (t.kind == Tag::EMPTY)
+    return retval.release();
+
+  boost::shared_ptr<Lazy_array_data> data(new Lazy_array_data(buf_));
+
+  for (t = sc.next_tag(t.end); t.kind != Tag::END; t = sc.next_tag(pos)) {
+    if (!sc.is(t, "value"))
+      throw XML_RPC_violation("unexpected tag <" + sc.name(t) + "> in array");
+
+    pos = sc.element_end(t);
+    data->ranges_.push_back(Lazy_range(t.begin, pos));
+  }
+
+  if (!data->ranges_.empty()) {
+    retval->values.resize(data->ranges_.size(), 0);
+    retval->lazy_ = data;
+  }
+
+  return retval.release();
+}
+
+Value_type*
+Lazy_parser::build_struct(size_t pos, bool empty) const
+{
+  std::auto_ptr<Struct> retval(new Struct);
+  if (empty)
+    return retval.release();
+
+  Scanner sc(*buf_);
+  boost::shared_ptr<Lazy_struct_data> data(new Lazy_struct_data(buf_));
+
+  for (Tag t = sc.next_tag(pos); t.kind != Tag::END; t = sc.next_tag(pos)) {
+    if (!sc.is(t, "member") || t.kind == Tag::EMPTY)
+      throw XML_RPC_violation("unexpected tag <" + sc.name(t) + "> in struct");
+
+    boost::optional<std::string> name;
+    boost::optional<Lazy_range> range;
+
+    Tag c = sc.next_tag(t.end);
+    for (; c.kind != Tag::END; c = sc.next_tag(pos)) {
+      if (!name && sc.is(c, "name")) {
+        Tag e = c.kind == Tag::EMPTY ? c : sc.skip_element(c);
+        name = sc.text(c.end, e.kind == Tag::EMPTY ? c.end : e.begin);
+        pos = e.end;
+      } else if (name && !range && sc.is(c, "value")) {
+        pos = sc.element_end(c);
+        range = Lazy_range(c.begin, pos);
+      } else {
+        throw XML_RPC_violation("unexpected tag <" + sc.name(c) + "> in struct");
+      }
+    }
+
+    if (!range)
+      throw XML_RPC_violation("struct member without value");
+
+    pos = c.end;
+    data->ranges_[name.get()] = range.get();
+  }
+
+  if (!data->ranges_.empty()) {
+    // Ranges are ordered by name the same way as members of Struct.
+    typedef std::map<std::string, Lazy_range>::const_iterator CI;
+    retval->values.reserve(data->ranges_.size());
+    for (CI i = data->ranges_.begin(); i != data->ranges_.end(); ++i)
+      retval->values.push_back(
+        std::make_pair(i->first, static_cast<Value*>(0)));
+
+    retval->lazy_ = data;
+  }
+
+  return retval.release();
+}
+
+Value_type*
+Lazy_parser::build_scalar(size_t pos) const
+{
+  Scanner sc(*buf_);
+  Tag t = sc.next_tag(pos);
+  std::string type;
+
+  if (t.kind != Tag::END) {
+    if (!sc.blank(pos, t.begin))
+      throw XML_RPC_violation("unexpected text in <value>");
+
+    type = sc.name(t);
+    pos = t.end;
+
+    if (t.kind == Tag::START) {
+      Tag e = sc.next_tag(pos);
+      if (e.kind != Tag::END)
+        throw XML_RPC_violation("unexpected tag <" + sc.name(e) + "> in <" + type + ">");
+
+      t = e;
+    }
+  }
+
+  // libxml2 does not report blank text, so regular parser sees no text either.
+  std::auto_ptr<Value_type> retval;
+  if (sc.blank(pos, t.begin)) {
+    retval.reset(build_scalar_value(type, 0));
+  } else {
+    std::string text(sc.text(pos, t.begin));
+    retval.reset(build_scalar_value(type, &text));
+  }
+
+  if (!retval.get())
+    throw XML_RPC_violation("unexpected tag <" + type + "> in <value>");
+
+  if (!type.empty() && sc.next_tag(t.end).kind != Tag::END)
+    throw XML_RPC_violation("unexpected tag after <" + type + ">");
+
+  return retval.release();
+}
+
+//
+// Document encoding
+//
+
+namespace {
+
+std::string
+declared_encoding(const std::string& s)
+{
+  if (s.compare(0, 5, "<?xml"))
+    return std::string();
+
+  size_t e = s.find("?>");
+  size_t i = s.find("encoding");
+  if (e == std::string::npos || i == std::string::npos || i > e)
+    return std::string();
+
+  i = s.find_first_of("\"'", i);
+  if (i == std::string::npos || i > e)
+    return std::string();
+
+  size_t q = s.find(s[i], i + 1);
+  return q < e ? s.substr(i + 1, q - i - 1) : std::string();
+}
+
+//! Frees libxml2's objects used for conversion.
+class Conversion: boost::noncopyable {
+public:
+  Conversion(xmlCharEncodingHandlerPtr h):
+    handler(h),
+    in(xmlBufferCreate()),
+    out(xmlBufferCreate()) {}
+
+  ~Conversion()
+  {
+    xmlBufferFree(in);
+    xmlBufferFree(out);
+    xmlCharEncCloseFunc(handler);
+  }
+
+  xmlCharEncodingHandlerPtr handler;
+  xmlBufferPtr in;
+  xmlBufferPtr out;
+};
+
+} // anonymous namespace
+
+boost::shared_ptr<const std::string>
+Lazy_parser::to_utf8(const boost::shared_ptr<const std::string>& buf)
+{
+  typedef boost::shared_ptr<const std::string> Buffer;
+  const std::string& s = *buf;
+
+  // Documents starting with byte order mark are not
+  // well-formed for Scanner and go to regular parser.
+  std::string name(declared_encoding(s));
+  if (name.empty())
+    return buf;
+
+  xmlCharEncodingHandlerPtr h = xmlFindCharEncodingHandler(name.c_str());
+  if (!h)
+    return Buffer();
+
+  if (!xmlStrcasecmp(reinterpret_cast<const xmlChar*>(h->name), BAD_CAST "UTF-8"))
+    return buf;
+
+  Conversion conv(h);
+  if (!conv.in || !conv.out ||
+      xmlBufferAdd(conv.in, reinterpret_cast<const xmlChar*>(s.data()), static_cast<int>(s.size())))
+  {
+    return Buffer();
+  }
+
+  while (xmlBufferLength(conv.in) > 0) {
+    if (xmlCharEncInFunc(h, conv.out, conv.in) <= 0)
+      return Buffer();
+  }
+
+  const char* data = reinterpret_cast<const char*>(xmlBufferContent(conv.out));
+  return Buffer(new std::string(data, xmlBufferLength(conv.out)));
+}
+
+} // namespace iqxmlrpc
+
+// vim:sw=2:ts=2:et:
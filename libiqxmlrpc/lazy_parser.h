@@ -0,0 +1,95 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_lazy_parser_h_
+#define _iqxmlrpc_lazy_parser_h_
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include "value.h"
+
+namespace iqxmlrpc {
+
+//! Byte range of <value>...</value> element within retained buffer.
+typedef std::pair<size_t, size_t> Lazy_range;
+
+//! Not yet decoded elements of lazy Array.
+class Lazy_array_data: boost::noncopyable {
+public:
+  Lazy_array_data(const boost::shared_ptr<const std::string>& buf):
+    buf_(buf) {}
+
+  Lazy_array_data* clone() const;
+
+  //! Decode element which was not accessed yet.
+  Value* decode(size_t idx) const;
+
+  boost::shared_ptr<const std::string> buf_;
+  std::vector<Lazy_range> ranges_;
+  boost::mutex lock_;
+};
+
+//! Not yet decoded members of lazy Struct.
+class Lazy_struct_data: boost::noncopyable {
+public:
+  Lazy_struct_data(const boost::shared_ptr<const std::string>& buf):
+    buf_(buf) {}
+
+  Lazy_struct_data* clone() const;
+
+  //! Decode member which was not accessed yet.
+  Value* decode(const std::string& name) const;
+
+  boost::shared_ptr<const std::string> buf_;
+  std::map<std::string, Lazy_range> ranges_;
+  boost::mutex lock_;
+};
+
+//! Builds lazy values on top of retained XML buffer.
+/*! Only the structure of arrays and structs is scanned (without libxml2).
+ *  Elements are decoded when accessed for the first time.
+ *  Scalars are decoded right from the buffer with the same
+ *  conversions as ValueBuilder does.
+ */
+class Lazy_parser {
+public:
+  Lazy_parser(const boost::shared_ptr<const std::string>& buf);
+
+  //! Returns document converted to UTF-8 as libxml2 does for regular parser.
+  //! Returns null if document's encoding is not supported.
+  static boost::shared_ptr<const std::string>
+  to_utf8(const boost::shared_ptr<const std::string>&);
+
+  //! Build value from <value> element which starts at specified position.
+  Value_type*
+  build_value(const Lazy_range&) const;
+
+  //! Find a range of <value> element of response.
+  /*! Whole document is checked first. Returns false if response is not
+   *  a regular non-fault one or it is left for regular parser.
+   */
+  bool
+  find_response_value(Lazy_range&) const;
+
+private:
+  Value_type*
+  build_array(size_t pos, bool empty) const;
+
+  Value_type*
+  build_struct(size_t pos, bool empty) const;
+
+  //! Build scalar from content of <value> element starting at pos.
+  Value_type*
+  build_scalar(size_t pos) const;
+
+  boost::shared_ptr<const std::string> buf_;
+};
+
+} // namespace iqxmlrpc
+
+#endif
+// vim:sw=2:ts=2:et:
@@ -18,5 +18,6 @@
 #include "method.h"
 #include "response.h"
 #include "value.h"
+#include "value_traits.h"
 
 #endif
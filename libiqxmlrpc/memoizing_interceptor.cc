@@ -0,0 +1,318 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "memoizing_interceptor.h"
+#include "value_hash.h"
+#include "value_type_xml.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include <list>
+#include <map>
+#include <time.h>
+#include <vector>
+
+namespace iqxmlrpc {
+
+typedef boost::mutex::scoped_lock scoped_lock;
+
+namespace {
+
+//! User name does not take part in call_hash(), so invalidation
+//! of particular call finds entries of all users.
+struct Cache_entry {
+  Cache_entry(
+    size_t h,
+    const std::string& m,
+    const std::string& u,
+    const Param_list& p,
+    const Value& r,
+    size_t result_size,
+    time_t e
+  ):
+    hash(h), method(m), user(u), params(p), result(r), size(0), expires(e)
+  {
+    size = sizeof(*this) + method.size() + user.size() + result_size;
+
+    for (Param_list::const_iterator i = params.begin(); i != params.end(); ++i)
+    {
+      Value_type_xml_size vis(false, false);
+      vis.visit(*i);
+      size += vis.size();
+    }
+  }
+
+  bool matches(const std::string& m, const Param_list& p) const
+  {
+    return method == m && params == p;
+  }
+
+  size_t hash;
+  std::string method;
+  std::string user;
+  Param_list params;
+  Value result;
+  size_t size;
+  time_t expires;
+};
+
+//! Part of the cache with own lock and LRU list.
+class Cache_shard {
+public:
+  Cache_shard(): memory(0) {}
+
+  //! Copies cached result of the call, if any.
+  bool find(size_t h, const Method& m, const Param_list& p, Value& result)
+  {
+    scoped_lock lk(lock);
+
+    Lru::iterator i = lookup(h, m.name(), m.authname(), p);
+    if (i == lru.end())
+      return false;
+
+    if (i->expires && i->expires <= time(0))
+    {
+      erase(i);
+      return false;
+    }
+
+    lru.splice(lru.begin(), lru, i);
+    result = i->result;
+    return true;
+  }
+
+  void insert(const Cache_entry& e, size_t limit)
+  {
+    if (e.size > limit)
+      return;
+
+    scoped_lock lk(lock);
+
+    // Concurrent call could already put the same result.
+    Lru::iterator i = lookup(e.hash, e.method, e.user, e.params);
+    if (i != lru.end())
+      erase(i);
+
+    lru.push_front(e);
+    index.insert(std::make_pair(e.hash, lru.begin()));
+    memory += e.size;
+
+    while (memory > limit)
+      erase(--lru.end());
+  }
+
+  void invalidate(const std::string& method)
+  {
+    scoped_lock lk(lock);
+
+    for (Lru::iterator i = lru.begin(); i != lru.end();)
+    {
+      Lru::iterator j = i++;
+      if (j->method == method)
+        erase(j);
+    }
+  }
+
+  void invalidate(size_t h, const std::string& method, const Param_list& p)
+  {
+    scoped_lock lk(lock);
+
+    std::pair<Index::iterator, Index::iterator> r = index.equal_range(h);
+    for (Index::iterator i = r.first; i != r.second;)
+    {
+      Lru::iterator j = i->second;
+      if (j->matches(method, p))
+      {
+        memory -= j->size;
+        lru.erase(j);
+        i = index.erase(i);
+      }
+      else
+      {
+        ++i;
+      }
+    }
+  }
+
+  void clear()
+  {
+    scoped_lock lk(lock);
+    index.clear();
+    lru.clear();
+    memory = 0;
+  }
+
+  size_t memory_used()
+  {
+    scoped_lock lk(lock);
+    return memory;
+  }
+
+private:
+  typedef std::list<Cache_entry> Lru;
+  typedef boost::unordered_multimap<size_t, Lru::iterator> Index;
+
+  Lru::iterator lookup(
+    size_t h, const std::string& method, const std::string& user, const Param_list& p)
+  {
+    std::pair<Index::iterator, Index::iterator> r = index.equal_range(h);
+    for (Index::iterator i = r.first; i != r.second; ++i)
+    {
+      if (i->second->user == user && i->second->matches(method, p))
+        return i->second;
+    }
+
+    return lru.end();
+  }
+
+  void erase(Lru::iterator e)
+  {
+    std::pair<Index::iterator, Index::iterator> r = index.equal_range(e->hash);
+    for (Index::iterator i = r.first; i != r.second; ++i)
+    {
+      if (i->second == e)
+      {
+        index.erase(i);
+        break;
+      }
+    }
+
+    memory -= e->size;
+    lru.erase(e);
+  }
+
+  boost::mutex lock;
+  Lru lru;
+  Index index;
+  size_t memory;
+};
+
+} // anonymous namespace
+
+//
+// Memoizing_interceptor::Impl
+//
+
+class Memoizing_interceptor::Impl {
+public:
+  Impl(size_t max_memory, unsigned nshards):
+    hits(0)
+  {
+    nshards = nshards ? nshards : 1;
+    shard_limit = max_memory / nshards;
+
+    for (unsigned i = 0; i < nshards; ++i)
+      shards.push_back(boost::shared_ptr<Cache_shard>(new Cache_shard));
+  }
+
+  Cache_shard& shard(size_t h)
+  {
+    return *shards[h % shards.size()];
+  }
+
+  typedef std::map<std::string, unsigned> Ttl_map;
+  Ttl_map methods;
+
+  std::vector<boost::shared_ptr<Cache_shard> > shards;
+  size_t shard_limit;
+  boost::detail::atomic_count hits;
+};
+
+//
+// Memoizing_interceptor
+//
+
+Memoizing_interceptor::Memoizing_interceptor(size_t max_memory, unsigned shards):
+  impl_(new Impl(max_memory, shards))
+{
+}
+
+Memoizing_interceptor::~Memoizing_interceptor()
+{
+}
+
+void Memoizing_interceptor::cache_method(const std::string& name, unsigned ttl)
+{
+  impl_->methods[name] = ttl;
+}
+
+void Memoizing_interceptor::invalidate(const std::string& method)
+{
+  for (size_t i = 0; i < impl_->shards.size(); ++i)
+    impl_->shards[i]->invalidate(method);
+}
+
+void Memoizing_interceptor::invalidate(const std::string& method, const Param_list& params)
+{
+  size_t h = call_hash(method, params);
+  impl_->shard(h).invalidate(h, method, params);
+}
+
+void Memoizing_interceptor::clear()
+{
+  for (size_t i = 0; i < impl_->shards.size(); ++i)
+    impl_->shards[i]->clear();
+}
+
+size_t Memoizing_interceptor::hits() const
+{
+  return impl_->hits;
+}
+
+size_t Memoizing_interceptor::memory_used() const
+{
+  size_t retval = 0;
+  for (size_t i = 0; i < impl_->shards.size(); ++i)
+    retval += impl_->shards[i]->memory_used();
+
+  return retval;
+}
+
+void Memoizing_interceptor::process(Method* m, const Param_list& params, Value& result)
+{
+  Impl::Ttl_map::const_iterator cfg = impl_->methods.find(m->name());
+  if (cfg == impl_->methods.end() || dynamic_cast<Streaming_method*>(m))
+  {
+    yield(m, params, result);
+    return;
+  }
+
+  size_t h = call_hash(m->name(), params);
+  Cache_shard& shard = impl_->shard(h);
+
+  if (shard.find(h, *m, params, result))
+  {
+    ++impl_->hits;
+    return;
+  }
+
+  yield(m, params, result);
+
+  // Cached copies must not refer to request's arena.
+  Value_arena::Scope no_arena(0);
+
+  // Result is cached as is and shared with the caller. Generated arrays
+  // can be traversed only once, so such results are serialized and
+  // the caller gets the same bytes that are cached.
+  Value_type_xml_size vis(true, false);
+  vis.visit(result);
+
+  size_t result_size = vis.size();
+  if (!vis.known())
+  {
+    Raw_xml_value* raw = Raw_xml_value::from_value(result);
+    result_size = raw->xml().size();
+    result = Value(raw);
+  }
+
+  time_t expires = cfg->second ? time(0) + cfg->second : 0;
+  shard.insert(
+    Cache_entry(h, m->name(), m->authname(), params, result, result_size, expires),
+    impl_->shard_limit);
+}
+
+} // namespace iqxmlrpc
+
+// vim:ts=2:sw=2:et
@@ -0,0 +1,73 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+/*! \file */
+#ifndef _iqxmlrpc_memoizing_interceptor_h_
+#define _iqxmlrpc_memoizing_interceptor_h_
+
+#include "method.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4251)
+#pragma warning(disable: 4275)
+#endif
+
+namespace iqxmlrpc {
+
+//! Interceptor which caches results of idempotent methods.
+/*! Result of a call is keyed by method name, parameters and name of
+ *  authenticated user. Repeated call with equal parameters (see
+ *  Value::equals()) is answered without calling the method, with
+ *  a copy-on-write copy of the cached result. Results containing
+ *  generated arrays are kept serialized and spliced into responses
+ *  (see Raw_xml_value). Faults are never cached.
+ *
+ *  Only methods enabled with cache_method() are cached. Configure them
+ *  before the server starts. Streaming methods are never cached.
+ *
+ *  Cache is split into shards with own locks and LRU lists.
+ *  Memory limit is approximate: it counts serialized size of results
+ *  and parameters. Least recently used entries are evicted first.
+ */
+class LIBIQXMLRPC_API Memoizing_interceptor: public Interceptor {
+public:
+  explicit Memoizing_interceptor(size_t max_memory = 64*1024*1024, unsigned shards = 16);
+  ~Memoizing_interceptor();
+
+  //! Cache results of specified method for ttl seconds.
+  //! Zero ttl means results never expire.
+  void cache_method(const std::string& name, unsigned ttl = 0);
+
+  //! Drop all cached results of specified method.
+  void invalidate(const std::string& method);
+
+  //! Drop cached results of the call with specified parameters.
+  void invalidate(const std::string& method, const Param_list&);
+
+  //! Drop all cached results.
+  void clear();
+
+  //! Number of calls answered from the cache.
+  size_t hits() const;
+
+  //! Approximate size of memory taken by cached results.
+  size_t memory_used() const;
+
+  void process(Method*, const Param_list&, Value&);
+
+private:
+  class Impl;
+  boost::scoped_ptr<Impl> impl_;
+};
+
+} // namespace iqxmlrpc
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#endif
+// vim:ts=2:sw=2:et
@@ -4,6 +4,7 @@
 #include "method.h"
 
 #include "except.h"
+#include "request_parser.h"
 #include "server.h" // Server_feedback
 #include "util.h"
 
@@ -36,3 +37,20 @@ void Method::process_execution(Interceptor* ic, const Param_list& params, Value&
     execute(params, result);
   }
 }
+
+// ----------------------------------------------------------------------------
+void Streaming_method::set_params_source(const boost::shared_ptr<Request_stream>& src)
+{
+  params_source_ = src;
+}
+
+void Streaming_method::execute(const Param_list&, Value& result)
+{
+  if (params_source_) {
+    boost::shared_ptr<Request_stream> src;
+    src.swap(params_source_);
+    src->stream_params(*this);
+  }
+
+  execute_streamed(result);
+}
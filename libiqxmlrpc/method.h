@@ -6,11 +6,13 @@
 
 #include "except.h"
 #include "inet_addr.h"
+#include "params_visitor.h"
 #include "value.h"
 #include "xheaders.h"
 
 #include <boost/utility.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <map>
 #include <string>
@@ -21,6 +23,7 @@ class Server;
 class Interceptor;
 class Method;
 class Method_dispatcher_base;
+class Request_stream;
 
 //! Method's parameters type
 typedef std::vector<Value> Param_list;
@@ -88,6 +91,30 @@ private:
 #pragma warning(disable: 4275)
 #endif
 
+//! Base for server methods that receive parameters as a stream of events.
+/*! Instead of building Param_list server parses parameters right before
+ *  execute_streamed() is called and reports them into Params_visitor
+ *  interface of the method. So memory consumption of such method
+ *  does not depend on the size of its parameters.
+ *
+ *  Note that interceptors are being called with empty Param_list
+ *  for streaming methods.
+ */
+class LIBIQXMLRPC_API Streaming_method: public Method, public Params_visitor {
+public:
+  //! Is is called by a server object.
+  void set_params_source(const boost::shared_ptr<Request_stream>&);
+
+private:
+  void execute( const Param_list&, Value& response );
+
+  //! Replace it with your actual code.
+  //! Called when all parameters were reported to the visitor.
+  virtual void execute_streamed( Value& response ) = 0;
+
+  boost::shared_ptr<Request_stream> params_source_;
+};
+
 //! Interceptor's base class
 /*! One can use interceptors in order to wrap actual XML-RPC calls
  *  on server side with code that supports particular aspect.
@@ -160,6 +187,10 @@ public:
   virtual ~Method_factory_base() {}
 
   virtual Method* create() = 0;
+
+  //! Fill the signature: return type followed by parameters' types.
+  //! Returns false if signature is unknown.
+  virtual bool signature(Array&) const { return false; }
 };
 
 
@@ -204,12 +235,25 @@ public:
     do_get_methods_list(retval);
   }
 
+  //! Append signatures of the method to the list.
+  //! Returns false if method's signatures are unknown.
+  bool get_method_signature(const std::string& name, Array& retval) const
+  {
+    return do_get_method_signature(name, retval);
+  }
+
 private:
   virtual Method*
   do_create_method(const std::string&) = 0;
 
   virtual void
   do_get_methods_list(Array&) const = 0;
+
+  virtual bool
+  do_get_method_signature(const std::string&, Array&) const
+  {
+    return false;
+  }
 };
 
 } // namespace iqxmlrpc
@@ -0,0 +1,117 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_params_visitor_h_
+#define _iqxmlrpc_params_visitor_h_
+
+#include "api_export.h"
+#include "value_type.h"
+
+namespace iqxmlrpc {
+
+//! Receives XML-RPC parameters as a stream of events while they are parsed.
+/*! Events mirror Value_type_visitor's ones, except compound values
+ *  are reported as begin/end pairs, so no Value tree has to be built.
+ *  Derived class should override private do_visit_xxx functions
+ *  it is interested in. Other events are ignored by default.
+ */
+class LIBIQXMLRPC_API Params_visitor {
+public:
+  virtual ~Params_visitor() {}
+
+  //! Called before each top-level parameter with its index.
+  void visit_param(size_t idx)
+  {
+    do_visit_param(idx);
+  }
+
+  void visit_nil()
+  {
+    do_visit_nil();
+  }
+
+  void visit_int(int val)
+  {
+    do_visit_int(val);
+  }
+
+  void visit_int64(int64_t val)
+  {
+    do_visit_int64(val);
+  }
+
+  void visit_double(double val)
+  {
+    do_visit_double(val);
+  }
+
+  void visit_bool(bool val)
+  {
+    do_visit_bool(val);
+  }
+
+  void visit_string(const std::string& val)
+  {
+    do_visit_string(val);
+  }
+
+  void visit_base64(const Binary_data& val)
+  {
+    do_visit_base64(val);
+  }
+
+  void visit_datetime(const Date_time& val)
+  {
+    do_visit_datetime(val);
+  }
+
+  void visit_array_begin()
+  {
+    do_visit_array_begin();
+  }
+
+  void visit_array_end()
+  {
+    do_visit_array_end();
+  }
+
+  void visit_struct_begin()
+  {
+    do_visit_struct_begin();
+  }
+
+  //! Called before value of each struct member.
+  void visit_member(const std::string& name)
+  {
+    do_visit_member(name);
+  }
+
+  void visit_struct_end()
+  {
+    do_visit_struct_end();
+  }
+
+private:
+  virtual void do_visit_param(size_t) {}
+
+  virtual void do_visit_nil() {}
+  virtual void do_visit_int(int) {}
+  virtual void do_visit_int64(int64_t) {}
+  virtual void do_visit_double(double) {}
+  virtual void do_visit_bool(bool) {}
+  virtual void do_visit_string(const std::string&) {}
+  virtual void do_visit_base64(const Binary_data&) {}
+  virtual void do_visit_datetime(const Date_time&) {}
+
+  virtual void do_visit_array_begin() {}
+  virtual void do_visit_array_end() {}
+
+  virtual void do_visit_struct_begin() {}
+  virtual void do_visit_member(const std::string&) {}
+  virtual void do_visit_struct_end() {}
+};
+
+} // namespace iqxmlrpc
+
+#endif
+// vim:ts=2:sw=2:et
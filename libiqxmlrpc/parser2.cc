@@ -3,10 +3,13 @@
 
 #include <algorithm>
 #include <stdexcept>
+#include <string.h>
 #include <libxml/xmlreader.h>
 #include <libxml/xmlIO.h>
+#include <boost/thread/tss.hpp>
 #include "parser2.h"
 #include "except.h"
+#include "util.h"
 #include <iostream>
 
 namespace iqxmlrpc {
@@ -56,6 +59,13 @@ BuilderBase::build(bool flat)
   parser_.parse(*this);
 }
 
+void
+BuilderBase::resume()
+{
+  want_exit_ = false;
+  parser_.parse(*this);
+}
+
 void
 BuilderBase::visit_element(const std::string& tag)
 {
@@ -99,22 +109,70 @@ BuilderBase::do_visit_text(const std::string&)
 
 class Parser::Impl {
 public:
-  Impl(const std::string& str):
-    buf(str),
+  Impl():
+    reader(0),
+    reader_uses(0),
+    reader_input(0),
     pushed_back(false)
   {
-    const char* buf2 = str.data();
-    int sz = static_cast<int>(str.size());
+  }
+
+  ~Impl()
+  {
+    if (reader)
+      xmlFreeTextReader(reader);
+  }
+
+  //! Prepare for parsing of new document.
+  void
+  reset(const std::string& str)
+  {
+    buf.assign(str);
+    curr = ParseStep();
+    pushed_back = false;
+
+    const char* buf2 = buf.data();
+    int sz = static_cast<int>(buf.size());
 #if (LIBXML_VERSION < 20703)
 #define XML_PARSE_HUGE 0
 #endif
-    reader = xmlReaderForMemory(buf2, sz, 0, 0, XML_PARSE_NONET | XML_PARSE_HUGE);
+    const int opts = XML_PARSE_NONET | XML_PARSE_HUGE;
+
+    if (reader && xmlReaderNewMemory(reader, buf2, sz, 0, 0, opts) < 0) {
+      xmlFreeTextReader(reader);
+      reader = 0;
+    }
+
+    if (!reader)
+      reader = xmlReaderForMemory(buf2, sz, 0, 0, opts);
+
+    if (!reader)
+      throw Parse_error("cannot create XML reader");
+
     xmlTextReaderSetParserProp(reader, XML_PARSER_SUBST_ENTITIES, 0); // No XXE
   }
 
-  ~Impl()
+  //! Drop document data before the object is put into pool.
+  void
+  release()
   {
-    xmlFreeTextReader(reader);
+    // Reused reader keeps its dictionary of names, which grows with
+    // every unique tag name. libxml2 does not expose its size, but it
+    // can not outgrow the input, so the reader is recreated after
+    // a number of documents or amount of data.
+    reader_input += buf.size();
+    if (++reader_uses >= max_reader_uses || reader_input > max_reader_input) {
+      xmlFreeTextReader(reader);
+      reader = 0;
+      reader_uses = 0;
+      reader_input = 0;
+    } else {
+      xmlTextReaderClose(reader);
+    }
+
+    // do not keep memory of occasional huge documents
+    if (buf.capacity() > max_retained_buffer)
+      std::string().swap(buf);
   }
 
   struct ParseStep {
@@ -185,15 +243,13 @@ public:
   std::string
   tag_name()
   {
-    std::string rv = to_string(xmlTextReaderName(reader));
+    // Name is interned by reader, so it does not need to be freed.
+    const char* name = reinterpret_cast<const char*>(xmlTextReaderConstName(reader));
+    if (!name)
+      return std::string();
 
-    size_t pos = rv.find_first_of(":");
-    if (pos != std::string::npos)
-    {
-      rv.erase(0, pos+1);
-    }
-
-    return rv;
+    const char* colon = strchr(name, ':');
+    return colon ? colon + 1 : name;
   }
 
   std::string
@@ -217,15 +273,93 @@ public:
     return to_string(xmlGetNodePath(n));
   }
 
-  const std::string buf;
+  static const size_t max_retained_buffer = 1024*1024;
+  static const unsigned max_reader_uses = 1000;
+  static const size_t max_reader_input = 16*1024*1024;
+
+  std::string buf;
   xmlTextReaderPtr reader;
+  unsigned reader_uses;
+  size_t reader_input;
   ParseStep curr;
   bool pushed_back;
 };
 
+//! Per-thread cache of parser states.
+/*! Parsers may be nested (e.g. a server method which is called while
+ *  the request is still being streamed may parse something by itself),
+ *  so pool keeps a few states rather than a single one.
+ */
+class Parser::Impl_pool: boost::noncopyable {
+public:
+  ~Impl_pool()
+  {
+    util::delete_ptrs(free_.begin(), free_.end());
+  }
+
+  static Impl*
+  acquire(const std::string& buf)
+  {
+    Impl_pool& p = instance();
+    Impl* impl = 0;
+
+    if (p.free_.empty()) {
+      impl = new Impl;
+    } else {
+      impl = p.free_.back();
+      p.free_.pop_back();
+    }
+
+    try {
+      impl->reset(buf);
+    } catch (...) {
+      delete impl;
+      throw;
+    }
+
+    return impl;
+  }
+
+  static void
+  release(Impl* impl)
+  {
+    Impl_pool& p = instance();
+
+    if (p.free_.size() >= max_size) {
+      delete impl;
+      return;
+    }
+
+    impl->release();
+    p.free_.push_back(impl);
+  }
+
+private:
+  static const size_t max_size = 4;
+
+  static Impl_pool&
+  instance()
+  {
+    if (!pool_.get())
+      pool_.reset(new Impl_pool);
+
+    return *pool_;
+  }
+
+  static boost::thread_specific_ptr<Impl_pool> pool_;
+  std::vector<Impl*> free_;
+};
+
+boost::thread_specific_ptr<Parser::Impl_pool> Parser::Impl_pool::pool_;
+
 Parser::Parser(const std::string& buf):
-  impl_(new Parser::Impl(buf))
+  impl_(Impl_pool::acquire(buf))
+{
+}
+
+Parser::~Parser()
 {
+  Impl_pool::release(impl_);
 }
 
 void
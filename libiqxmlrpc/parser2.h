@@ -7,7 +7,7 @@
 #include <map>
 #include <string>
 #include <vector>
-#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
 
 namespace iqxmlrpc {
 
@@ -47,6 +47,10 @@ public:
   void
   build(bool flat = false);
 
+  //! Continue parsing after builder has requested an exit.
+  void
+  resume();
+
 protected:
   template <class R, class BUILDER>
   R
@@ -78,9 +82,11 @@ protected:
   bool want_exit_;
 };
 
-class Parser {
+//! Pull parser. Its libxml2 state is reused by further parsers of the same thread.
+class Parser: boost::noncopyable {
 public:
   Parser(const std::string& buf);
+  ~Parser();
 
   void
   parse(BuilderBase& builder);
@@ -93,7 +99,8 @@ public:
 
 private:
   class Impl;
-  boost::shared_ptr<Impl> impl_;
+  class Impl_pool;
+  Impl* impl_;
 };
 
 class StateMachine {
@@ -22,10 +22,44 @@ parse_request( const std::string& request_string )
   return builder.get();
 }
 
+namespace {
+
+boost::optional<size_t>
+request_size(const Request& request, bool exact)
+{
+  size_t sz = XmlBuilder::declaration_size() +
+    sizeof("<methodCall></methodCall>\n") - 1 +
+    Value_type_xml_size::text_node_size("methodName", request.get_name());
+
+  if (request.get_params().empty())
+    return sz + sizeof("<params/>") - 1;
+
+  Value_type_xml_size size_visitor(false, exact);
+  BOOST_FOREACH(const Value& v, request.get_params()) {
+    size_visitor.visit(v);
+  }
+
+  if (!size_visitor.known())
+    return boost::optional<size_t>();
+
+  return sz + size_visitor.size() + sizeof("<params></params>") - 1 +
+    request.get_params().size() * (sizeof("<param></param>") - 1);
+}
+
+} // anonymous namespace
+
+boost::optional<size_t>
+dump_request_size(const Request& request)
+{
+  return request_size(request, true);
+}
+
 std::string
 dump_request(const Request& request)
 {
   XmlBuilder writer;
+  if (boost::optional<size_t> sz = request_size(request, false))
+    writer.reserve(*sz);
   XmlBuilder::Node root(writer, "methodCall");
 
   {
@@ -42,7 +76,10 @@ dump_request(const Request& request)
   }
 
   writer.stop();
-  return writer.content();
+
+  std::string retval;
+  writer.swap_content(retval);
+  return retval;
 }
 
 //
@@ -6,6 +6,7 @@
 
 #include <string>
 #include <vector>
+#include <boost/optional.hpp>
 
 #include "value.h"
 
@@ -20,6 +21,10 @@ LIBIQXMLRPC_API  Request* parse_request( const std::string& );
 //! Dump Request to XML.
 LIBIQXMLRPC_API std::string dump_request( const Request& );
 
+//! Exact size of dump_request() output, computed without serialization.
+//! Nothing is returned if request contains generated arrays.
+LIBIQXMLRPC_API boost::optional<size_t> dump_request_size( const Request& );
+
 #ifdef _MSC_VER
 #pragma warning(push)
 #pragma warning(disable: 4251)
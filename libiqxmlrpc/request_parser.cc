@@ -4,6 +4,7 @@
 #include <stdexcept>
 #include <boost/lexical_cast.hpp>
 #include "except.h"
+#include "params_visitor.h"
 #include "request_parser.h"
 #include "value_parser.h"
 
@@ -18,9 +19,12 @@ enum RequestBuilderState {
   VALUE
 };
 
-RequestBuilder::RequestBuilder(Parser& parser):
+RequestBuilder::RequestBuilder(Parser& parser, bool stop_on_name):
   BuilderBase(parser),
-  state_(parser, NONE)
+  state_(parser, NONE),
+  stop_on_name_(stop_on_name),
+  params_visitor_(0),
+  param_idx_(0)
 {
   static const StateMachine::StateTransition trans[] = {
     { NONE, METHOD_CALL, "methodCall" },
@@ -40,21 +44,60 @@ RequestBuilder::do_visit_element(const std::string& tagname)
   switch (state_.change(tagname)) {
   case METHOD_NAME:
     method_name_ = parser_.get_data();
+    if (stop_on_name_)
+      want_exit();
     break;
 
   case VALUE:
-    params_.push_back(sub_build<Value_type*, ValueBuilder>(true));
+    if (params_visitor_) {
+      params_visitor_->visit_param(param_idx_++);
+      ValueStreamer s(parser_, *params_visitor_);
+      s.stream(true);
+    } else {
+      params_.push_back(sub_build<Value_type*, ValueBuilder>(true));
+    }
     break;
   }
 }
 
-Request*
-RequestBuilder::get()
+const std::string&
+RequestBuilder::method_name() const
 {
   if (!method_name_)
     throw XML_RPC_violation("No method name specified");
 
-  return new Request(method_name_.get(), params_);
+  return method_name_.get();
+}
+
+Request*
+RequestBuilder::get()
+{
+  return new Request(method_name(), params_);
+}
+
+//
+// Request_stream
+//
+
+Request_stream::Request_stream(const std::string& buf):
+  parser_(buf),
+  builder_(parser_, true)
+{
+  builder_.build();
+}
+
+Request*
+Request_stream::get_request()
+{
+  builder_.resume();
+  return builder_.get();
+}
+
+void
+Request_stream::stream_params(Params_visitor& v)
+{
+  builder_.set_params_visitor(&v);
+  builder_.resume();
 }
 
 } // namespace iqxmlrpc
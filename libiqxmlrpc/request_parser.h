@@ -5,18 +5,32 @@
 #define _iqxmlrpc_request_parser_h_
 
 #include <boost/optional.hpp>
+#include <boost/utility.hpp>
 #include "parser2.h"
 #include "request.h"
 
 namespace iqxmlrpc {
 
+class Params_visitor;
+
 class RequestBuilder: public BuilderBase {
 public:
-  RequestBuilder(Parser&);
+  //! \param stop_on_name Pause parsing as soon as method name is read.
+  RequestBuilder(Parser&, bool stop_on_name = false);
 
   Request*
   get();
 
+  const std::string&
+  method_name() const;
+
+  //! Report parameters into visitor instead of building them.
+  void
+  set_params_visitor(Params_visitor* v)
+  {
+    params_visitor_ = v;
+  }
+
 private:
   virtual void
   do_visit_element(const std::string&);
@@ -24,6 +38,36 @@ private:
   StateMachine state_;
   boost::optional<std::string> method_name_;
   Param_list params_;
+  bool stop_on_name_;
+  Params_visitor* params_visitor_;
+  size_t param_idx_;
+};
+
+//! Two-phase request parser.
+/*! Reads method name first. Then the rest of request can either be
+ *  built as usual or its parameters can be streamed into Params_visitor.
+ */
+class Request_stream: boost::noncopyable {
+public:
+  Request_stream(const std::string& buf);
+
+  const std::string&
+  method_name() const
+  {
+    return builder_.method_name();
+  }
+
+  //! Parse parameters and return complete request.
+  Request*
+  get_request();
+
+  //! Parse parameters reporting them into visitor.
+  void
+  stream_params(Params_visitor&);
+
+private:
+  Parser parser_;
+  RequestBuilder builder_;
 };
 
 } // namespace iqxmlrpc
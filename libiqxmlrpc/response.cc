@@ -7,6 +7,7 @@
 #include "response_parser.h"
 
 #include "except.h"
+#include "lazy_parser.h"
 #include "value.h"
 #include "value_type_xml.h"
 #include "xml_builder.h"
@@ -22,27 +23,83 @@ parse_response( const std::string& response_string )
   return builder.get();
 }
 
+Response
+parse_response_lazy( const boost::shared_ptr<const std::string>& buf )
+{
+  // Faults and unusual documents are handled by regular parser.
+  boost::shared_ptr<const std::string> doc = Lazy_parser::to_utf8(buf);
+  if (!doc)
+    return parse_response(*buf);
+
+  Lazy_parser parser(doc);
+  Lazy_range range;
+
+  if (!parser.find_response_value(range))
+    return parse_response(*buf);
+
+  return Response(new Value(parser.build_value(range)));
+}
+
+namespace {
+
+boost::optional<size_t>
+response_size( const Response& response, bool exact )
+{
+  const size_t doc_size = XmlBuilder::declaration_size() + sizeof("\n") - 1;
+  Value_type_xml_size size_visitor(true, exact);
+
+  if (!response.is_fault()) {
+    size_visitor.visit(response.value());
+    if (!size_visitor.known())
+      return boost::optional<size_t>();
+
+    return doc_size + size_visitor.size() +
+      sizeof("<methodResponse><params><param></param></params></methodResponse>") - 1;
+  }
+
+  Struct fault;
+  fault.insert( "faultCode", response.fault_code() );
+  fault.insert( "faultString", response.fault_string() );
+  size_visitor.visit(Value(fault));
+
+  return doc_size + size_visitor.size() +
+    sizeof("<methodResponse><fault></fault></methodResponse>") - 1;
+}
+
+} // anonymous namespace
+
+boost::optional<size_t>
+dump_response_size( const Response& response )
+{
+  return response_size( response, true );
+}
+
 std::string
 dump_response( const Response& response )
 {
   XmlBuilder writer;
+  if (boost::optional<size_t> sz = response_size(response, false))
+    writer.reserve(*sz);
   XmlBuilder::Node root(writer, "methodResponse");
   Value_type_to_xml value_xml_visitor(writer, true);
 
   if (!response.is_fault()) {
     XmlBuilder::Node params(writer, "params");
     XmlBuilder::Node param(writer, "param");
-    response.value().apply_visitor(value_xml_visitor);
+    value_xml_visitor.visit(response.value());
   } else {
     XmlBuilder::Node fault_node(writer, "fault");
     Struct fault;
     fault.insert( "faultCode", response.fault_code() );
     fault.insert( "faultString", response.fault_string() );
-    Value(fault).apply_visitor(value_xml_visitor);
+    value_xml_visitor.visit(Value(fault));
   }
 
   writer.stop();
-  return writer.content();
+
+  std::string retval;
+  writer.swap_content(retval);
+  return retval;
 }
 
 //
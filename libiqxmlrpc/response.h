@@ -4,14 +4,15 @@
 #ifndef _iqxmlrpc_response_h_
 #define _iqxmlrpc_response_h_
 
+#include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 #include <string>
 #include "api_export.h"
+#include "value_traits.h"
 
 namespace iqxmlrpc {
 
 class Response;
-class Value;
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -21,9 +22,22 @@ class Value;
 //! Build response object from XML-formed string.
 LIBIQXMLRPC_API Response parse_response( const std::string& );
 
+//! Build response object which decodes its value on demand.
+/*! Only the layout of arrays and structs is scanned at this point,
+ *  their elements are parsed when they are accessed for the first time.
+ *  The buffer is retained while any part of the value tree is alive.
+ *  Malformed documents are reported here, while elements with invalid
+ *  values (e.g. non-numeric <int>) are reported on access.
+ */
+LIBIQXMLRPC_API Response parse_response_lazy( const boost::shared_ptr<const std::string>& );
+
 //! Dump response to XML.
 LIBIQXMLRPC_API std::string dump_response( const Response& );
 
+//! Exact size of dump_response() output, computed without serialization.
+//! Nothing is returned if response contains generated arrays.
+LIBIQXMLRPC_API boost::optional<size_t> dump_response_size( const Response& );
+
 //! XML-RPC response.
 class LIBIQXMLRPC_API Response {
 public:
@@ -33,6 +47,15 @@ public:
   //! Returns response value or throws iqxmlrpc::Fault in case of fault.
   const Value& value() const;
 
+  //! Converts response value into native type.
+  /*! With lazy responses only parts used by the type are decoded.
+   *  \see Value_traits */
+  template <class T>
+  T value_as() const
+  {
+    return Value_traits<T>::from_value(value());
+  }
+
   //! Check whether response is an XML-RPC Fault Reponse.
   bool is_fault()   const { return !value_; }
   //! Returns fault code of Fault Response.
@@ -50,6 +73,14 @@ private:
 #pragma warning(pop)
 #endif
 
+//! Parse response and convert its value into native type.
+/*! Throws iqxmlrpc::Fault in case of fault response. \see Value_traits */
+template <class T>
+inline T parse_response_as( const std::string& s )
+{
+  return parse_response(s).value_as<T>();
+}
+
 } // namespace iqxmlrpc
 
 #endif
@@ -0,0 +1,132 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "response_serializer.h"
+#include "value_type_xml.h"
+
+namespace iqxmlrpc {
+
+Response_serializer::Response_serializer(const Response& r, size_t chunk_size):
+  resp_(r),
+  chunk_size_(chunk_size),
+  started_(false)
+{
+}
+
+void
+Response_serializer::push_value(const Value& v)
+{
+  if (v.is_array()) {
+    builder_.start_element("value");
+    builder_.start_element("array");
+    builder_.start_element("data");
+
+    stack_.push_back(Frame(&v.the_array()));
+  } else if (v.is_struct()) {
+    builder_.start_element("value");
+    builder_.start_element("struct");
+
+    stack_.push_back(Frame(&v.the_struct()));
+  } else if (v.is_generated_array()) {
+    builder_.start_element("value");
+    builder_.start_element("array");
+    builder_.start_element("data");
+
+    stack_.push_back(Frame(&v.the_generated_array().generator()));
+  } else {
+    Value_type_to_xml vis(builder_, true);
+    vis.visit(v);
+  }
+}
+
+void
+Response_serializer::step()
+{
+  Frame& f = stack_.back();
+
+  if (f.arr || f.gen) {
+    if (f.arr && f.idx < f.arr->size()) {
+      if (const Packed_array_base* p = f.arr->packed()) {
+        Value_type_to_xml vis(builder_, true);
+        Value_type_static_adapter<Value_type_to_xml> adapter(vis);
+        p->visit_element(f.idx++, adapter);
+        return;
+      }
+
+      // Frame reference is invalidated by push_value().
+      push_value((*f.arr)[f.idx++]);
+      return;
+    }
+
+    if (f.gen) {
+      f.current.reset(f.gen->next());
+      if (f.current) {
+        // Element is kept by the frame until the next one is pulled.
+        boost::shared_ptr<Value> cur(f.current);
+        push_value(*cur);
+        return;
+      }
+    }
+
+    builder_.end_element(); // data
+    builder_.end_element(); // array
+    builder_.end_element(); // value
+    stack_.pop_back();
+    return;
+  }
+
+  if (f.in_member) {
+    builder_.end_element(); // member
+    f.in_member = false;
+    ++f.it;
+    return;
+  }
+
+  if (f.it != f.st->end()) {
+    f.in_member = true;
+    builder_.start_element("member");
+    {
+      XmlBuilder::Node name(builder_, "name");
+      name.set_textdata(f.it->first);
+    }
+    push_value(*f.it->second);
+    return;
+  }
+
+  builder_.end_element(); // struct
+  builder_.end_element(); // value
+  stack_.pop_back();
+}
+
+bool
+Response_serializer::next_chunk(std::string& out)
+{
+  out.erase();
+
+  if (!started_) {
+    started_ = true;
+
+    if (resp_.is_fault()) {
+      dump_response(resp_).swap(out);
+      return false;
+    }
+
+    builder_.start_element("methodResponse");
+    builder_.start_element("params");
+    builder_.start_element("param");
+    push_value(resp_.value());
+  }
+
+  while (!stack_.empty() && builder_.size() < chunk_size_)
+    step();
+
+  bool more = !stack_.empty();
+  if (!more)
+    builder_.stop();
+
+  builder_.swap_content(out);
+  return more;
+}
+
+} // namespace iqxmlrpc
+// vim:ts=2:sw=2:et
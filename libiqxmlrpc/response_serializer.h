@@ -0,0 +1,66 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_response_serializer_h_
+#define _iqxmlrpc_response_serializer_h_
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include "response.h"
+#include "value.h"
+#include "xml_builder.h"
+
+namespace iqxmlrpc {
+
+//! Serializes response into XML by parts of limited size.
+/*! Arrays and structs are walked with an explicit stack, so the work can be
+ *  suspended as soon as enough output is produced. The concatenation of all
+ *  chunks is exactly what dump_response() returns. Fault responses are small
+ *  and produced in one go.
+ */
+class Response_serializer: boost::noncopyable {
+public:
+  Response_serializer(const Response&, size_t chunk_size);
+
+  //! Put next part of document into out (its content is replaced).
+  //! Returns false when the last part was produced.
+  bool next_chunk(std::string& out);
+
+private:
+  struct Frame {
+    explicit Frame(const Array* a):
+      arr(a), idx(0), st(0), in_member(false), gen(0) {}
+
+    explicit Frame(const Struct* s):
+      arr(0), idx(0), st(s), it(s->begin()), in_member(false), gen(0) {}
+
+    explicit Frame(Array_generator* g):
+      arr(0), idx(0), st(0), in_member(false), gen(g) {}
+
+    const Array* arr;
+    size_t idx;
+    const Struct* st;
+    Struct::const_iterator it;
+    bool in_member;
+    Array_generator* gen;
+    //! Element of generated array being serialized.
+    boost::shared_ptr<Value> current;
+  };
+
+  void push_value(const Value&);
+  void step();
+
+  Response resp_;
+  size_t chunk_size_;
+  XmlBuilder builder_;
+  std::vector<Frame> stack_;
+  bool started_;
+};
+
+} // namespace iqxmlrpc
+
+#endif
+// vim:ts=2:sw=2:et
@@ -0,0 +1,184 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "serialization_pool.h"
+
+#include "except.h"
+#include "value.h"
+#include "value_type_xml.h"
+#include "xml_builder.h"
+
+#include <boost/bind.hpp>
+
+namespace iqxmlrpc {
+
+namespace {
+
+boost::mutex pool_lock;
+boost::shared_ptr<Serialization_pool> current_pool;
+
+// Each thread gets several ranges, so uneven elements are balanced.
+const size_t ranges_per_thread = 4;
+
+} // anonymous namespace
+
+//! Counts finished tasks of a single serialize() call.
+class Serialization_pool::Latch {
+public:
+  Latch(size_t n): left_(n) {}
+
+  void count_down(const std::string* error = 0)
+  {
+    boost::mutex::scoped_lock lk(lock_);
+    if (error && error_.empty())
+      error_ = *error;
+
+    if (!--left_)
+      cond_.notify_all();
+  }
+
+  bool done()
+  {
+    boost::mutex::scoped_lock lk(lock_);
+    return !left_;
+  }
+
+  void wait()
+  {
+    boost::mutex::scoped_lock lk(lock_);
+    while (left_)
+      cond_.wait(lk);
+
+    if (!error_.empty())
+      throw Exception("Serialization failed: " + error_);
+  }
+
+private:
+  boost::mutex lock_;
+  boost::condition cond_;
+  size_t left_;
+  std::string error_;
+};
+
+boost::shared_ptr<Serialization_pool>
+Serialization_pool::instance()
+{
+  boost::mutex::scoped_lock lk(pool_lock);
+  return current_pool;
+}
+
+void
+Serialization_pool::configure(unsigned threads, size_t min_array_size)
+{
+  boost::shared_ptr<Serialization_pool> p;
+  if (threads)
+    p.reset(new Serialization_pool(threads, min_array_size));
+
+  boost::mutex::scoped_lock lk(pool_lock);
+  // Previous pool is stopped when its last user releases it.
+  current_pool.swap(p);
+}
+
+Serialization_pool::Serialization_pool(unsigned threads, size_t min_array_size):
+  min_array_size_(min_array_size),
+  num_threads_(threads),
+  stop_(false)
+{
+  for (unsigned i = 0; i < threads; ++i)
+    threads_.create_thread(boost::bind(&Serialization_pool::work, this));
+}
+
+Serialization_pool::~Serialization_pool()
+{
+  {
+    boost::mutex::scoped_lock lk(lock_);
+    stop_ = true;
+    cond_.notify_all();
+  }
+
+  threads_.join_all();
+}
+
+void
+Serialization_pool::run(const Task& t)
+{
+  try {
+    XmlBuilder builder(false);
+    Value_type_to_xml vis(builder, t.server_mode, false);
+
+    for (size_t i = t.begin; i < t.end; ++i)
+      vis.visit((*t.arr)[i]);
+
+    builder.swap_content(*t.out);
+    t.done->count_down();
+  }
+  catch (const std::exception& e) {
+    std::string err(e.what());
+    t.done->count_down(&err);
+  }
+  catch (...) {
+    std::string err("unknown error");
+    t.done->count_down(&err);
+  }
+}
+
+bool
+Serialization_pool::pop(Task& t, bool wait)
+{
+  boost::mutex::scoped_lock lk(lock_);
+
+  while (wait && tasks_.empty() && !stop_)
+    cond_.wait(lk);
+
+  if (tasks_.empty())
+    return false;
+
+  t = tasks_.front();
+  tasks_.pop_front();
+  return true;
+}
+
+void
+Serialization_pool::work()
+{
+  for (Task t; pop(t, true);)
+    run(t);
+}
+
+void
+Serialization_pool::serialize(
+  const Array& arr, bool server_mode, std::vector<std::string>& parts)
+{
+  size_t num = std::min<size_t>((num_threads_ + 1) * ranges_per_thread, arr.size());
+  parts.assign(num, std::string());
+  Latch done(num);
+
+  std::vector<Task> tasks(num);
+  for (size_t i = 0; i < num; ++i) {
+    Task t = {
+      &arr,
+      arr.size() * i / num,
+      arr.size() * (i + 1) / num,
+      server_mode,
+      &parts[i],
+      &done
+    };
+    tasks[i] = t;
+  }
+
+  {
+    boost::mutex::scoped_lock lk(lock_);
+    tasks_.insert(tasks_.end(), tasks.begin() + 1, tasks.end());
+    cond_.notify_all();
+  }
+
+  // Help workers instead of waiting for them.
+  run(tasks[0]);
+  for (Task t; !done.done() && pop(t, false);)
+    run(t);
+
+  done.wait();
+}
+
+} // namespace iqxmlrpc
+// vim:ts=2:sw=2:et
@@ -0,0 +1,72 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_serialization_pool_h_
+#define _iqxmlrpc_serialization_pool_h_
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/utility.hpp>
+
+namespace iqxmlrpc {
+
+class Array;
+
+//! Threads which serialize ranges of large arrays in parallel.
+/*! Array is split into ranges of elements, each range is serialized
+ *  into a separate buffer. The calling thread serializes ranges too,
+ *  so it never waits for idle pool. Ranges are serialized serially
+ *  inside, nested arrays are not split again.
+ */
+class Serialization_pool: boost::noncopyable {
+public:
+  //! Returns current pool or empty pointer if parallel serialization is off.
+  static boost::shared_ptr<Serialization_pool> instance();
+
+  //! Replace current pool. Zero threads turns parallel serialization off.
+  static void configure(unsigned threads, size_t min_array_size);
+
+  Serialization_pool(unsigned threads, size_t min_array_size);
+  ~Serialization_pool();
+
+  size_t min_array_size() const { return min_array_size_; }
+
+  //! Serialize elements of array. Concatenation of parts is the same
+  //! as the output of serial Value_type_to_xml for the elements.
+  void serialize(const Array&, bool server_mode, std::vector<std::string>& parts);
+
+private:
+  class Latch;
+
+  struct Task {
+    const Array* arr;
+    size_t begin;
+    size_t end;
+    bool server_mode;
+    std::string* out;
+    Latch* done;
+  };
+
+  static void run(const Task&);
+
+  bool pop(Task&, bool wait);
+  void work();
+
+  size_t min_array_size_;
+  unsigned num_threads_;
+  boost::mutex lock_;
+  boost::condition cond_;
+  std::deque<Task> tasks_;
+  bool stop_;
+  boost::thread_group threads_;
+};
+
+} // namespace iqxmlrpc
+
+#endif
+// vim:ts=2:sw=2:et
@@ -3,6 +3,7 @@
 
 #include <boost/optional.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <memory>
 
 #include "server.h"
@@ -11,7 +12,9 @@
 #include "reactor.h"
 #include "reactor_interrupter.h"
 #include "request.h"
+#include "request_parser.h"
 #include "response.h"
+#include "response_serializer.h"
 #include "server_conn.h"
 #include "xheaders.h"
 
@@ -32,6 +35,8 @@ public:
   bool exit_flag;
   std::ostream* log;
   size_t max_req_sz;
+  size_t resp_chunk_sz;
+  bool request_arena;
   http::Verification_level ver_level;
 
   Method_dispatcher_manager  disp_manager;
@@ -52,6 +57,8 @@ public:
       exit_flag(false),
       log(0),
       max_req_sz(0),
+      resp_chunk_sz(0),
+      request_arena(false),
       ver_level(http::HTTP_CHECK_WEAK),
       interceptors(0),
       auth_plugin(0)
@@ -125,6 +132,21 @@ size_t Server::get_max_request_sz() const
   return impl->max_req_sz;
 }
 
+void Server::set_response_chunk_sz( size_t sz )
+{
+  impl->resp_chunk_sz = sz;
+}
+
+size_t Server::get_response_chunk_sz() const
+{
+  return impl->resp_chunk_sz;
+}
+
+void Server::set_request_arena( bool enable )
+{
+  impl->request_arena = enable;
+}
+
 void Server::set_verification_level( http::Verification_level lev )
 {
   impl->ver_level = lev;
@@ -188,24 +210,46 @@ void Server::schedule_execute( http::Packet* pkt, Server_connection* conn )
   try {
     scoped_ptr<http::Packet> packet(pkt);
     optional<std::string> authname = authenticate(*pkt, impl->auth_plugin);
-    scoped_ptr<Request> req( parse_request(packet->content()) );
+
+    // Declared first, so it is released after everything
+    // that may hold request's values.
+    boost::shared_ptr<Value_arena> arena;
+    if (impl->request_arena)
+      arena.reset(new Value_arena);
+
+    boost::shared_ptr<Request_stream> req_stream(
+      new Request_stream(packet->content()));
 
     Method::Data mdata = {
-      req->get_name(),
+      req_stream->method_name(),
       conn->get_peer_addr(),
       Server_feedback(this)
     };
 
-    Method* meth = impl->disp_manager.create_method( mdata );
+    std::auto_ptr<Method> meth( impl->disp_manager.create_method( mdata ) );
 
     if (authname)
       meth->authname(authname.get());
 
     pkt->header()->get_xheaders(meth->xheaders());
 
-    executor = impl->exec_factory->create( meth, this, conn );
+    // Streaming methods parse their parameters by themselves
+    // at the moment of execution.
+    scoped_ptr<Request> req;
+    if (Streaming_method* sm = dynamic_cast<Streaming_method*>(meth.get()))
+    {
+      sm->set_params_source(req_stream);
+    }
+    else
+    {
+      Value_arena::Scope scope(arena.get());
+      req.reset(req_stream->get_request());
+    }
+
+    executor = impl->exec_factory->create( meth.release(), this, conn );
     executor->set_interceptors(impl->interceptors.get());
-    executor->execute( req->get_params() );
+    executor->set_arena(arena);
+    executor->execute( req ? req->get_params() : Param_list() );
   }
   catch( const iqxmlrpc::http::Error_response& e )
   {
@@ -238,11 +282,51 @@ void Server::schedule_response(
   const Response& resp, Server_connection* conn, Executor* exec )
 {
   std::auto_ptr<Executor> executor_to_delete(exec);
-  std::string resp_str = dump_response(resp);
-  http::Packet *packet = new http::Packet(new http::Response_header(), resp_str);
+
+  if (impl->resp_chunk_sz)
+  {
+    // Clients that do not accept chunked encoding get streamed
+    // response only if its length is known beforehand.
+    bool chunked = conn->accepts_chunked();
+    boost::optional<size_t> length;
+    if (!chunked)
+      length = dump_response_size(resp);
+
+    if (chunked || length)
+    {
+      boost::shared_ptr<Response_serializer> s(
+        new Response_serializer(resp, impl->resp_chunk_sz));
+
+      std::string first;
+      if (s->next_chunk(first))
+      {
+        http::Packet *packet = new http::Packet(new http::Response_header(), first);
+
+        if (chunked)
+          packet->set_chunked();
+        else
+          packet->set_content_length(*length);
+
+        conn->schedule_response( packet, s );
+        return;
+      }
+
+      // Small response fits into a single part.
+      conn->schedule_response( new http::Packet(new http::Response_header(), first) );
+      return;
+    }
+  }
+
+  http::Packet *packet =
+    new http::Packet(new http::Response_header(), dump_response(resp));
   conn->schedule_response( packet );
 }
 
+void Server::schedule_response_chunk( Server_connection* conn )
+{
+  impl->exec_factory->schedule_response_chunk( this, conn );
+}
+
 void Server::set_firewall( iqnet::Firewall_base* _firewall )
 {
    impl->firewall = _firewall;
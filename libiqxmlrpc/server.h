@@ -64,6 +64,23 @@ public:
   void set_max_request_sz( size_t );
   size_t get_max_request_sz() const;
 
+  //! Stream responses to HTTP/1.1 clients using chunked transfer encoding.
+  /*! Response is serialized by parts of about specified size, each part
+      is sent before the next one is produced. Zero (default) turns it off.
+      Responses to HTTP/1.0 clients are streamed with Content-Length
+      computed beforehand, unless they contain generated arrays.
+      Parts after the first one are serialized by executor's threads.
+  */
+  void set_response_chunk_sz( size_t );
+  size_t get_response_chunk_sz() const;
+
+  //! Allocate parameters of each request from a single Value_arena.
+  /*! The arena is released in one shot when request's executor finishes,
+      instead of freeing every node of parameters' tree one by one.
+      Parameters must not be retained by methods, copy them instead.
+  */
+  void set_request_arena( bool );
+
   //! Set optional firewall object.
   void set_firewall( iqnet::Firewall_base* );
 
@@ -90,6 +107,9 @@ public:
   void schedule_execute( http::Packet*, Server_connection* );
   void schedule_response( const Response&, Server_connection*, Executor* );
 
+  //! Ask executor factory to produce next part of streamed response.
+  void schedule_response_chunk( Server_connection* );
+
   void log_err_msg( const std::string& );
 
 protected:
@@ -4,6 +4,7 @@
 #include "server_conn.h"
 #include "auth_plugin.h"
 #include "http_errors.h"
+#include "response_serializer.h"
 #include "server.h"
 
 using namespace iqxmlrpc;
@@ -12,7 +13,9 @@ Server_connection::Server_connection( const iqnet::Inet_addr& a ):
   peer_addr(a),
   server(0),
   keep_alive(false),
-  read_buf_(65536, '\0')
+  accepts_chunked_(false),
+  read_buf_(65536, '\0'),
+  chunked_(false)
 {
 }
 
@@ -32,8 +35,10 @@ http::Packet* Server_connection::read_request( const std::string& s )
 
     if( r ) {
       keep_alive = r->header()->conn_keep_alive();
+      accepts_chunked_ =
+        static_cast<const http::Request_header*>(r->header())->version() == "HTTP/1.1";
     } else if( preader.expect_continue() ) {
-      response = "HTTP/1.1 100\r\n\r\n";
+      response.push( "HTTP/1.1 100\r\n\r\n" );
       keep_alive = true;
       do_schedule_response();
       preader.set_continue_sent();
@@ -52,8 +57,69 @@ void Server_connection::schedule_response( http::Packet* pkt )
 {
   std::auto_ptr<http::Packet> p(pkt);
   p->set_keep_alive( keep_alive );
-  response = p->dump();
+  p->dump( response );
   do_schedule_response();
 }
 
+
+void Server_connection::schedule_response(
+  http::Packet* pkt, const boost::shared_ptr<Response_serializer>& s )
+{
+  std::auto_ptr<http::Packet> p(pkt);
+  p->set_keep_alive( keep_alive );
+  p->dump( response );
+  serializer_ = s;
+  chunked_ = p->header()->chunked();
+  do_schedule_response();
+}
+
+
+void Server_connection::produce_response_chunk()
+{
+  try {
+    // Parts may be empty until serializer gets to the next value.
+    while( response.empty() && response_pending() )
+      next_response_chunk();
+  }
+  catch( const std::exception& e )
+  {
+    // Headers are already sent, so the peer learns about
+    // the failure from unexpectedly closed connection.
+    server->log_err_msg( std::string("Server: streamed response failed: ") + e.what() );
+    serializer_.reset();
+    keep_alive = false;
+  }
+  catch( ... )
+  {
+    server->log_err_msg( "Server: streamed response failed: unknown exception." );
+    serializer_.reset();
+    keep_alive = false;
+  }
+
+  do_schedule_response();
+}
+
+
+void Server_connection::next_response_chunk()
+{
+  std::string chunk;
+  bool more = serializer_->next_chunk( chunk );
+
+  if( !chunked_ )
+    response.take( chunk );
+  else if( !chunk.empty() )
+    http::dump_chunk( response, chunk );
+
+  if( !more )
+  {
+    if( chunked_ )
+    {
+      std::string last;
+      http::dump_chunk( response, last );
+    }
+
+    serializer_.reset();
+  }
+}
+
 // vim:ts=2:sw=2:et
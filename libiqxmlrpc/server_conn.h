@@ -5,6 +5,7 @@
 #define _iqxmlrpc_server_conn_h_
 
 #include <vector>
+#include <boost/shared_ptr.hpp>
 #include "connection.h"
 #include "conn_factory.h"
 #include "http.h"
@@ -17,6 +18,7 @@ namespace iqnet
 namespace iqxmlrpc {
 
 class Server;
+class Response_serializer;
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -29,8 +31,9 @@ protected:
   iqnet::Inet_addr peer_addr;
   Server *server;
   http::Packet_reader preader;
-  std::string response;
+  iqnet::Send_queue response;
   bool keep_alive;
+  bool accepts_chunked_;
 
 public:
   Server_connection( const iqnet::Inet_addr& );
@@ -43,18 +46,40 @@ public:
     server = s;
   }
 
+  //! Whether peer can receive a response with chunked transfer encoding.
+  bool accepts_chunked() const { return accepts_chunked_; }
+
   void schedule_response( http::Packet* );
 
+  //! Send packet and then parts of body produced by serializer
+  //! as soon as previous ones are written to the socket.
+  //! Parts are sent as chunks if packet uses chunked transfer encoding.
+  void schedule_response( http::Packet*, const boost::shared_ptr<Response_serializer>& );
+
+  //! Produce next part of streamed response and schedule its sending.
+  /*! Connection must not have handlers registered in reactor while
+   *  the part is produced, so it can be called from any thread.
+   *  \see Server::schedule_response_chunk()
+   */
+  void produce_response_chunk();
+
 protected:
   http::Packet* read_request( const std::string& );
 
+  //! Whether streamed response has more parts to produce.
+  bool response_pending() const { return serializer_.get() != 0; }
+
   char* read_buf() { return &read_buf_[0]; }
   size_t read_buf_sz() const { return read_buf_.size(); }
 
   virtual void do_schedule_response() = 0;
 
 private:
+  void next_response_chunk();
+
   std::vector<char> read_buf_;
+  boost::shared_ptr<Response_serializer> serializer_;
+  bool chunked_;
 };
 
 #ifdef _MSC_VER
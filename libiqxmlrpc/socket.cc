@@ -6,6 +6,10 @@
 #include "socket.h"
 #include "net_except.h"
 
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
+
 #if _MSC_VER >= 1700
 #include <ws2tcpip.h>
 #endif
@@ -83,6 +87,45 @@ size_t Socket::send( const char* data, size_t len )
   return static_cast<size_t>(ret);
 }
 
+size_t Socket::send( const Io_buffer* bufs, size_t count )
+{
+  const size_t max_count = 16;
+  if( count > max_count )
+    count = max_count;
+
+#ifdef WIN32
+  WSABUF wbufs[max_count];
+  for( size_t i = 0; i < count; ++i )
+  {
+    wbufs[i].buf = const_cast<char*>(bufs[i].data);
+    wbufs[i].len = static_cast<ULONG>(bufs[i].size);
+  }
+
+  DWORD ret = 0;
+  if( WSASend( sock, wbufs, static_cast<DWORD>(count), &ret, 0, 0, 0 ) == SOCKET_ERROR )
+    throw network_error( "Socket::send" );
+#else
+  struct iovec iov[max_count];
+  for( size_t i = 0; i < count; ++i )
+  {
+    iov[i].iov_base = const_cast<char*>(bufs[i].data);
+    iov[i].iov_len = bufs[i].size;
+  }
+
+  struct msghdr msg;
+  memset( &msg, 0, sizeof(msg) );
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+
+  ssize_t ret = ::sendmsg( sock, &msg, IQXMLRPC_NOPIPE );
+
+  if( ret == -1 )
+    throw network_error( "Socket::send" );
+#endif //WIN32
+
+  return static_cast<size_t>(ret);
+}
+
 size_t Socket::recv( char* buf, size_t len )
 {
   int ret = ::recv( sock, buf, static_cast<int>(len), 0 );
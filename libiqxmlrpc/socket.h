@@ -9,6 +9,12 @@
 namespace iqnet
 {
 
+//! Memory block for scatter-gather IO.
+struct Io_buffer {
+  const char* data;
+  size_t size;
+};
+
 //! Relatively portable socket class.
 class LIBIQXMLRPC_API Socket {
 public:
@@ -40,6 +46,9 @@ public:
 
   /*! \b Can \b not cause SIGPIPE signal. */
   virtual size_t send( const char*, size_t );
+  /*! Sends several buffers with single system call.
+      \b Can \b not cause SIGPIPE signal. */
+  virtual size_t send( const Io_buffer*, size_t count );
   virtual void send_shutdown( const char*, size_t );
   /*! \b Can \b not cause SIGPIPE signal. */
   virtual size_t recv( char*, size_t );
@@ -94,6 +94,18 @@ size_t ssl::Connection::send( const char* data, size_t len )
 }
 
 
+size_t ssl::Connection::send( Send_queue& q )
+{
+  Io_buffer b = q.front();
+  if( !b.size )
+    return 0;
+
+  size_t sz = send( b.data, b.size );
+  q.advance( sz );
+  return sz;
+}
+
+
 size_t ssl::Connection::recv( char* buf, size_t len )
 {
   int ret = SSL_read( ssl, buf, static_cast<int>(len) );
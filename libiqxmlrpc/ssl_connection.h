@@ -26,6 +26,8 @@ public:
 
   void shutdown();
   size_t send( const char*, size_t );
+  //! SSL records are written segment by segment.
+  size_t send( Send_queue& );
   size_t recv( char*, size_t );
 
   //! Does ssl_accept()
@@ -0,0 +1,268 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+/*! \file */
+#ifndef _iqxmlrpc_typed_method_h_
+#define _iqxmlrpc_typed_method_h_
+
+#include "method.h"
+#include "server.h"
+#include "value_traits.h"
+
+#include <boost/function.hpp>
+#include <boost/type_traits/remove_cv.hpp>
+#include <boost/type_traits/remove_reference.hpp>
+
+namespace iqxmlrpc {
+namespace detail {
+
+//! Parameter of typed method.
+template <class A>
+struct Typed_param {
+  typedef typename boost::remove_cv<
+    typename boost::remove_reference<A>::type>::type type;
+
+  static type get(const Param_list& params, size_t idx)
+  {
+    try {
+      return Value_traits<type>::from_value(params[idx]);
+    }
+    catch (const Value::Bad_cast&)
+    {
+      throw Invalid_meth_params();
+    }
+    catch (const Struct::No_field&)
+    {
+      throw Invalid_meth_params();
+    }
+    catch (const Array::Out_of_range&)
+    {
+      throw Invalid_meth_params();
+    }
+  }
+
+  static void signature(Array& sig)
+  {
+    sig.push_back(Value(Value_traits<type>::type_name()));
+  }
+};
+
+//! Calls function and stores its result.
+template <class R>
+struct Typed_result {
+  static void signature(Array& sig)
+  {
+    sig.push_back(Value(Value_traits<R>::type_name()));
+  }
+
+  template <class F>
+  static void call(Value& r, F& f)
+  { r = Value_traits<R>::to_value(f()); }
+
+  template <class F, class A1>
+  static void call(Value& r, F& f, const A1& a1)
+  { r = Value_traits<R>::to_value(f(a1)); }
+
+  template <class F, class A1, class A2>
+  static void call(Value& r, F& f, const A1& a1, const A2& a2)
+  { r = Value_traits<R>::to_value(f(a1, a2)); }
+
+  template <class F, class A1, class A2, class A3>
+  static void call(Value& r, F& f, const A1& a1, const A2& a2, const A3& a3)
+  { r = Value_traits<R>::to_value(f(a1, a2, a3)); }
+
+  template <class F, class A1, class A2, class A3, class A4>
+  static void call(Value& r, F& f,
+    const A1& a1, const A2& a2, const A3& a3, const A4& a4)
+  { r = Value_traits<R>::to_value(f(a1, a2, a3, a4)); }
+};
+
+//! Functions returning void respond with nil.
+template <>
+struct Typed_result<void> {
+  static void signature(Array& sig)
+  {
+    sig.push_back(Value("nil"));
+  }
+
+  template <class F>
+  static void call(Value& r, F& f)
+  { f(); r = Nil(); }
+
+  template <class F, class A1>
+  static void call(Value& r, F& f, const A1& a1)
+  { f(a1); r = Nil(); }
+
+  template <class F, class A1, class A2>
+  static void call(Value& r, F& f, const A1& a1, const A2& a2)
+  { f(a1, a2); r = Nil(); }
+
+  template <class F, class A1, class A2, class A3>
+  static void call(Value& r, F& f, const A1& a1, const A2& a2, const A3& a3)
+  { f(a1, a2, a3); r = Nil(); }
+
+  template <class F, class A1, class A2, class A3, class A4>
+  static void call(Value& r, F& f,
+    const A1& a1, const A2& a2, const A3& a3, const A4& a4)
+  { f(a1, a2, a3, a4); r = Nil(); }
+};
+
+inline void check_params_count(const Param_list& params, size_t n)
+{
+  if (params.size() != n)
+    throw Invalid_meth_params();
+}
+
+//! Converts parameters and calls function of specified signature.
+//! Up to four parameters are supported.
+template <class Signature>
+struct Typed_call;
+
+template <class R>
+struct Typed_call<R()> {
+  static void call(boost::function<R()>& f, const Param_list& p, Value& r)
+  {
+    check_params_count(p, 0);
+    Typed_result<R>::call(r, f);
+  }
+
+  static void signature(Array& sig)
+  {
+    Typed_result<R>::signature(sig);
+  }
+};
+
+template <class R, class A1>
+struct Typed_call<R(A1)> {
+  static void call(boost::function<R(A1)>& f, const Param_list& p, Value& r)
+  {
+    check_params_count(p, 1);
+    typename Typed_param<A1>::type a1(Typed_param<A1>::get(p, 0));
+    Typed_result<R>::call(r, f, a1);
+  }
+
+  static void signature(Array& sig)
+  {
+    Typed_result<R>::signature(sig);
+    Typed_param<A1>::signature(sig);
+  }
+};
+
+template <class R, class A1, class A2>
+struct Typed_call<R(A1, A2)> {
+  static void call(boost::function<R(A1, A2)>& f, const Param_list& p, Value& r)
+  {
+    check_params_count(p, 2);
+    typename Typed_param<A1>::type a1(Typed_param<A1>::get(p, 0));
+    typename Typed_param<A2>::type a2(Typed_param<A2>::get(p, 1));
+    Typed_result<R>::call(r, f, a1, a2);
+  }
+
+  static void signature(Array& sig)
+  {
+    Typed_result<R>::signature(sig);
+    Typed_param<A1>::signature(sig);
+    Typed_param<A2>::signature(sig);
+  }
+};
+
+template <class R, class A1, class A2, class A3>
+struct Typed_call<R(A1, A2, A3)> {
+  static void call(boost::function<R(A1, A2, A3)>& f, const Param_list& p, Value& r)
+  {
+    check_params_count(p, 3);
+    typename Typed_param<A1>::type a1(Typed_param<A1>::get(p, 0));
+    typename Typed_param<A2>::type a2(Typed_param<A2>::get(p, 1));
+    typename Typed_param<A3>::type a3(Typed_param<A3>::get(p, 2));
+    Typed_result<R>::call(r, f, a1, a2, a3);
+  }
+
+  static void signature(Array& sig)
+  {
+    Typed_result<R>::signature(sig);
+    Typed_param<A1>::signature(sig);
+    Typed_param<A2>::signature(sig);
+    Typed_param<A3>::signature(sig);
+  }
+};
+
+template <class R, class A1, class A2, class A3, class A4>
+struct Typed_call<R(A1, A2, A3, A4)> {
+  static void call(boost::function<R(A1, A2, A3, A4)>& f, const Param_list& p, Value& r)
+  {
+    check_params_count(p, 4);
+    typename Typed_param<A1>::type a1(Typed_param<A1>::get(p, 0));
+    typename Typed_param<A2>::type a2(Typed_param<A2>::get(p, 1));
+    typename Typed_param<A3>::type a3(Typed_param<A3>::get(p, 2));
+    typename Typed_param<A4>::type a4(Typed_param<A4>::get(p, 3));
+    Typed_result<R>::call(r, f, a1, a2, a3, a4);
+  }
+
+  static void signature(Array& sig)
+  {
+    Typed_result<R>::signature(sig);
+    Typed_param<A1>::signature(sig);
+    Typed_param<A2>::signature(sig);
+    Typed_param<A3>::signature(sig);
+    Typed_param<A4>::signature(sig);
+  }
+};
+
+} // namespace detail
+
+//! Server method made of function with native C++ signature.
+/*! Parameters are checked against the signature and converted
+ *  by Value_traits before the call, mismatch results in
+ *  Invalid_meth_params fault. Result is converted back into Value.
+ *  \see register_method(Server&, const std::string&, F)
+ */
+template <class Signature>
+class Typed_method: public Method {
+public:
+  Typed_method(const boost::function<Signature>& f):
+    function(f) {}
+
+private:
+  void execute(const Param_list& params, Value& result)
+  {
+    detail::Typed_call<Signature>::call(function, params, result);
+  }
+
+  boost::function<Signature> function;
+};
+
+//! Factory for typed methods. Knows methods' signature.
+template <class Signature>
+class Typed_method_factory: public Method_factory_base {
+public:
+  Typed_method_factory(const boost::function<Signature>& f):
+    function(f) {}
+
+  Method* create() { return new Typed_method<Signature>(function); }
+
+  bool signature(Array& sig) const
+  {
+    detail::Typed_call<Signature>::signature(sig);
+    return true;
+  }
+
+private:
+  boost::function<Signature> function;
+};
+
+//! Register function or functor "fn" with specified signature
+//! as handler for call "name" with specific server.
+/*! E.g. register_method<int(int, std::string)>(server, "name", fn);
+ *  Signature is reported by system.methodSignature when introspection
+ *  is enabled.
+ */
+template <class Signature, class F>
+inline void register_method(Server& server, const std::string& name, F fn)
+{
+  server.register_method(name, new Typed_method_factory<Signature>(fn));
+}
+
+} // namespace iqxmlrpc
+
+#endif
+// vim:ts=2:sw=2:et
@@ -1,9 +1,12 @@
 //  Libiqxmlrpc - an object-oriented XML-RPC solution.
 //  Copyright (C) 2014 Anton Dedov
 
+#include <algorithm>
 #include <boost/optional.hpp>
 #include <stdexcept>
+#include <string.h>
 
+#include "serialization_pool.h"
 #include "value.h"
 #include "value_type_visitor.h"
 #include "value_type_xml.h"
@@ -19,6 +22,7 @@ namespace ValueOptions {
   boost::optional<int> default_int;
   boost::optional<int64_t> default_int64;
   bool omit_string_tag_in_responses = false;
+  bool pack_numeric_arrays = false;
 }
 
 void Value::set_default_int(int dint)
@@ -56,137 +60,318 @@ void Value::omit_string_tag_in_responses(bool v)
   ValueOptions::omit_string_tag_in_responses = v;
 }
 
+void Value::set_parallel_serialization(unsigned threads, size_t min_array_size)
+{
+  Serialization_pool::configure(threads, min_array_size);
+}
+
 bool Value::omit_string_tag_in_responses()
 {
   return ValueOptions::omit_string_tag_in_responses;
 }
 
-Value::Value( Value_type* v ):
-  value(v)
+void Value::pack_numeric_arrays(bool v)
 {
+  ValueOptions::pack_numeric_arrays = v;
+}
+
+bool Value::pack_numeric_arrays()
+{
+  return ValueOptions::pack_numeric_arrays;
+}
+
+// Scalars produced by parser are folded into inline storage.
+Value::Value( Value_type* v ):
+  storage(HEAP),
+  str_len(0)
+{
+  data.value = v;
+  if (!v)
+    return;
+
+  const std::type_info& t = typeid(*v);
+
+  if (t == typeid(Nil)) {
+    storage = NIL;
+  } else if (t == typeid(Int)) {
+    storage = INT;
+    data.int_value = static_cast<Int*>(v)->value();
+  } else if (t == typeid(Int64)) {
+    storage = INT64;
+    data.int64_value = static_cast<Int64*>(v)->value();
+  } else if (t == typeid(Bool)) {
+    storage = BOOL;
+    data.bool_value = static_cast<Bool*>(v)->value();
+  } else if (t == typeid(Double)) {
+    storage = DOUBLE;
+    data.double_value = static_cast<Double*>(v)->value();
+  } else if (t == typeid(String)) {
+    const std::string& str = static_cast<String*>(v)->value();
+    if (str.size() > short_string_max)
+      return;
+
+    set_string(str.data(), str.size());
+  } else {
+    return;
+  }
+
+  delete v;
 }
 
 Value::Value( const Value& v ):
-  value( v.value->clone() )
+  data(v.data),
+  storage(v.storage),
+  str_len(v.str_len)
 {
+  if (storage == HEAP)
+    data.value = share(v.data.value);
 }
 
-Value::Value( Nil n ):
-  value( n.clone() )
+Value::Value( Nil ):
+  storage(NIL),
+  str_len(0)
 {
 }
 
 Value::Value( int i ):
-  value( new Int(i) )
+  storage(INT),
+  str_len(0)
 {
+  data.int_value = i;
 }
 
 Value::Value( int64_t i ):
-  value( new Int64(i) )
+  storage(INT64),
+  str_len(0)
 {
+  data.int64_value = i;
 }
 
 Value::Value( bool b ):
-  value( new Bool(b) )
+  storage(BOOL),
+  str_len(0)
 {
+  data.bool_value = b;
 }
 
 Value::Value( double d ):
-  value( new Double(d) )
+  storage(DOUBLE),
+  str_len(0)
 {
+  data.double_value = d;
 }
 
 Value::Value( std::string s ):
-  value( new String(s) )
+  storage(HEAP),
+  str_len(0)
 {
+  if (s.size() <= short_string_max) {
+    set_string(s.data(), s.size());
+    return;
+  }
+
+  String* str = new String(std::string());
+  str->value().swap(s);
+  data.value = str;
 }
 
 Value::Value( const char* s ):
-  value( new String(s) )
+  storage(HEAP),
+  str_len(0)
 {
+  size_t len = strlen(s);
+  if (len <= short_string_max)
+    set_string(s, len);
+  else
+    data.value = new String(s);
 }
 
 Value::Value( const Array& arr ):
-  value( arr.clone() )
+  storage(HEAP),
+  str_len(0)
 {
+  data.value = arr.clone();
 }
 
 Value::Value( const Struct& st ):
-  value( st.clone() )
+  storage(HEAP),
+  str_len(0)
+{
+  data.value = st.clone();
+}
+
+Value::Value( const Generated_array& ga ):
+  storage(HEAP),
+  str_len(0)
 {
+  data.value = ga.clone();
 }
 
 Value::Value( const Binary_data& bin ):
-  value( bin.clone() )
+  storage(HEAP),
+  str_len(0)
 {
+  data.value = bin.clone();
 }
 
 Value::Value( const Date_time& dt ):
-  value( dt.clone() )
+  storage(HEAP),
+  str_len(0)
 {
+  data.value = dt.clone();
 }
 
 Value::Value( const struct tm* dt ):
-  value( new Date_time(dt) )
+  storage(HEAP),
+  str_len(0)
 {
+  data.value = new Date_time(dt);
 }
 
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+Value::Value( Value&& v ) noexcept:
+  data(v.data),
+  storage(v.storage),
+  str_len(v.str_len)
+{
+  v.storage = NIL;
+}
+
+Value::Value( Array&& arr ):
+  storage(HEAP),
+  str_len(0)
+{
+  Array* a = new Array;
+  a->swap(arr);
+  data.value = a;
+}
+
+Value::Value( Struct&& st ):
+  storage(HEAP),
+  str_len(0)
+{
+  Struct* s = new Struct;
+  s->swap(st);
+  data.value = s;
+}
+#endif
+
 Value::~Value()
 {
-  delete value;
+  if (storage == HEAP)
+    release(data.value);
+}
+
+// Objects living in arena are never shared
+// since copies may outlive the arena.
+Value_type* Value::share( Value_type* v )
+{
+  if (!v)
+    return 0;
+
+  if (!v->shareable_ || Value_arena::is_arena_node(dynamic_cast<const void*>(v)))
+    return v->clone();
+
+  ++v->refs_;
+  return v;
+}
+
+void Value::release( Value_type* v )
+{
+  if (v && --v->refs_ == 0)
+    delete v;
+}
+
+void Value::set_string( const char* s, size_t len )
+{
+  storage = SHORT_STRING;
+  str_len = static_cast<unsigned char>(len);
+  memcpy(data.str_value, s, len);
+}
+
+void Value::swap( Value& v ) throw()
+{
+  std::swap(data, v.data);
+  std::swap(storage, v.storage);
+  std::swap(str_len, v.str_len);
 }
 
 template <class T>
 T* Value::cast() const
 {
-  T* t = dynamic_cast<T*>( value );
+  T* t = storage == HEAP ? dynamic_cast<T*>( data.value ) : 0;
   if( !t )
     throw Bad_cast();
   return t;
 }
 
+template <class T>
+T* Value::mutable_cast()
+{
+  T* t = cast<T>();
+
+  if (t->refs_ > 1)
+  {
+    Value_type* copy = t->clone();
+    release(data.value);
+    data.value = copy;
+    t = static_cast<T*>(copy);
+  }
+
+  // Caller may keep the reference, so further copies must not share it.
+  t->shareable_ = false;
+  return t;
+}
+
 template <class T>
 bool Value::can_cast() const
 {
-  return dynamic_cast<T*>( value ) != NULL;
+  return storage == HEAP && dynamic_cast<T*>( data.value ) != NULL;
 }
 
 const Value& Value::operator =( const Value& v )
 {
-  Value_type* tmp = v.value->clone();
-  delete value;
-  value = tmp;
+  Value tmp(v);
+  swap(tmp);
+  return *this;
+}
+
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+Value& Value::operator =( Value&& v ) noexcept
+{
+  swap(v);
   return *this;
 }
+#endif
 
 bool Value::is_nil() const
 {
-  return can_cast<Nil>();
+  return storage == NIL || can_cast<Nil>();
 }
 
 bool Value::is_int() const
 {
-  return can_cast<Int>();
+  return storage == INT || can_cast<Int>();
 }
 
 bool Value::is_int64() const
 {
-  return can_cast<Int64>();
+  return storage == INT64 || can_cast<Int64>();
 }
 
 bool Value::is_bool() const
 {
-  return can_cast<Bool>();
+  return storage == BOOL || can_cast<Bool>();
 }
 
 bool Value::is_double() const
 {
-  return can_cast<Double>();
+  return storage == DOUBLE || can_cast<Double>();
 }
 
 bool Value::is_string() const
 {
-  return can_cast<String>();
+  return storage == SHORT_STRING || can_cast<String>();
 }
 
 bool Value::is_binary() const
@@ -208,33 +393,51 @@ bool Value::is_struct() const
 {
   return can_cast<Struct>();
 }
+
+bool Value::is_generated_array() const
+{
+  return can_cast<Generated_array>();
+}
+
+// Scalar types return references to static names.
 const std::string& Value::type_name() const
 {
-  return value->type_name();
+  switch (storage) {
+  case NIL:           return Nil().type_name();
+  case INT:           return Int(0).type_name();
+  case INT64:         return Int64(0).type_name();
+  case BOOL:          return Bool(false).type_name();
+  case DOUBLE:        return Double(0).type_name();
+  case SHORT_STRING:  return String(std::string()).type_name();
+  default:            return data.value->type_name();
+  }
 }
 
 int Value::get_int() const
 {
-  return cast<Int>()->value();
+  return storage == INT ? data.int_value : cast<Int>()->value();
 }
 
 int64_t Value::get_int64() const
 {
-  return cast<Int64>()->value();
+  return storage == INT64 ? data.int64_value : cast<Int64>()->value();
 }
 
 bool Value::get_bool() const
 {
-  return cast<Bool>()->value();
+  return storage == BOOL ? data.bool_value : cast<Bool>()->value();
 }
 
 double Value::get_double() const
 {
-  return cast<Double>()->value();
+  return storage == DOUBLE ? data.double_value : cast<Double>()->value();
 }
 
 std::string Value::get_string() const
 {
+  if (storage == SHORT_STRING)
+    return std::string(data.str_value, str_len);
+
   return cast<String>()->value();
 }
 
@@ -285,7 +488,7 @@ Value::operator struct tm() const
 
 Array& Value::the_array()
 {
-  return *cast<Array>();
+  return *mutable_cast<Array>();
 }
 
 const Array& Value::the_array() const
@@ -293,6 +496,11 @@ const Array& Value::the_array() const
   return *cast<Array>();
 }
 
+const Generated_array& Value::the_generated_array() const
+{
+  return *cast<Generated_array>();
+}
+
 size_t Value::size() const
 {
   return cast<Array>()->size();
@@ -300,7 +508,7 @@ size_t Value::size() const
 
 void Value::push_back( const Value& v )
 {
-  cast<Array>()->push_back(v);
+  mutable_cast<Array>()->push_back(v);
 }
 
 const Value& Value::operator []( int i ) const
@@ -311,7 +519,7 @@ const Value& Value::operator []( int i ) const
 
 Value& Value::operator []( int i )
 {
-  return (*cast<Array>())[i];
+  return (*mutable_cast<Array>())[i];
 }
 
 Array::const_iterator Value::arr_begin() const
@@ -326,7 +534,7 @@ Array::const_iterator Value::arr_end() const
 
 Struct& Value::the_struct()
 {
-  return *cast<Struct>();
+  return *mutable_cast<Struct>();
 }
 
 const Struct& Value::the_struct() const
@@ -346,7 +554,7 @@ const Value& Value::operator []( const std::string& s ) const
 
 Value& Value::operator []( const std::string& s )
 {
-  return (*cast<Struct>())[s];
+  return (*mutable_cast<Struct>())[s];
 }
 
 const Value& Value::operator []( const char* s ) const
@@ -356,17 +564,63 @@ const Value& Value::operator []( const char* s ) const
 
 Value& Value::operator []( const char* s )
 {
-  return (*cast<Struct>())[s];
+  return (*mutable_cast<Struct>())[s];
 }
 
 void Value::insert( const std::string& n, const Value& v )
 {
-  cast<Struct>()->insert(n,v);
+  mutable_cast<Struct>()->insert(n,v);
 }
 
+// Inline scalars are visited through temporary Value_type objects.
 void Value::apply_visitor(Value_type_visitor& v) const
 {
-  v.visit_value(*value);
+  switch (storage) {
+  case NIL:
+    {
+      Nil tmp;
+      v.visit_value(tmp);
+      break;
+    }
+
+  case INT:
+    {
+      Int tmp(data.int_value);
+      v.visit_value(tmp);
+      break;
+    }
+
+  case INT64:
+    {
+      Int64 tmp(data.int64_value);
+      v.visit_value(tmp);
+      break;
+    }
+
+  case BOOL:
+    {
+      Bool tmp(data.bool_value);
+      v.visit_value(tmp);
+      break;
+    }
+
+  case DOUBLE:
+    {
+      Double tmp(data.double_value);
+      v.visit_value(tmp);
+      break;
+    }
+
+  case SHORT_STRING:
+    {
+      String tmp(std::string(data.str_value, str_len));
+      v.visit_value(tmp);
+      break;
+    }
+
+  default:
+    v.visit_value(*data.value);
+  }
 }
 
 //
@@ -376,7 +630,7 @@ void Value::apply_visitor(Value_type_visitor& v) const
 void value_to_xml(XmlBuilder& builder, const Value& v)
 {
   Value_type_to_xml vis(builder);
-  v.apply_visitor(vis);
+  vis.visit(v);
 }
 
 void print_value(const Value& v, std::ostream& s)
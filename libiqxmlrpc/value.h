@@ -26,7 +26,31 @@ public:
   };
 
 private:
-  Value_type* value;
+  //! Kind of content. Scalars are kept inline, without Value_type object.
+  enum Storage {
+    HEAP,
+    NIL,
+    INT,
+    INT64,
+    BOOL,
+    DOUBLE,
+    SHORT_STRING
+  };
+
+  //! Strings up to this length are kept inline.
+  enum { short_string_max = 15 };
+
+  union Data {
+    Value_type* value;
+    int int_value;
+    int64_t int64_value;
+    bool bool_value;
+    double double_value;
+    char str_value[short_string_max];
+  } data;
+
+  unsigned char storage;
+  unsigned char str_len;
 
 public:
   Value( Value_type* );
@@ -43,11 +67,29 @@ public:
   Value( const struct tm* );
   Value( const Array& );
   Value( const Struct& );
+  Value( const Generated_array& );
+
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+  //! Steals the content. Moved-from value becomes Nil.
+  Value( Value&& ) noexcept;
+  Value( Array&& );
+  Value( Struct&& );
+#endif
 
   virtual ~Value();
 
+  //! Placed into current Value_arena if any.
+  static void* operator new( size_t sz ) { return Value_arena::allocate_node(sz); }
+  static void operator delete( void* p ) { Value_arena::release_node(p); }
+  static void* operator new( size_t, void* p ) { return p; }
+  static void operator delete( void*, void* ) {}
+
   const Value& operator =( const Value& );
 
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+  Value& operator =( Value&& ) noexcept;
+#endif
+
   //! \name Type identification
   //! \{
   bool is_nil()    const;
@@ -60,6 +102,7 @@ public:
   bool is_datetime() const;
   bool is_array()  const;
   bool is_struct() const;
+  bool is_generated_array() const;
 
   const std::string& type_name() const;
   //! \}
@@ -115,8 +158,43 @@ public:
   void insert( const std::string& n, const Value& v );
   //! \}
 
+  //! Access inner Generated_array value.
+  const Generated_array& the_generated_array() const;
+
+  //! \name Comparison
+  //! \{
+  //! Deep comparison of content. Types must match: int 1 is not equal
+  //! to i8 1 or double 1.0. Generated arrays are equal only to own copies.
+  bool equals( const Value& ) const;
+
+  //! Structural hash consistent with equals().
+  /*! Hashes of arrays and structs produced by parser are computed
+   *  while parsing and cached in nodes, so it takes constant time
+   *  for request parameters and responses until they are modified.
+   */
+  size_t hash() const;
+  //! \}
+
   void apply_visitor(Value_type_visitor&) const;
 
+  //! Visit built-in types without virtual calls.
+  /*! Visitor is any class with non-virtual methods visit_nil(),
+   *  visit_int(int), visit_int64(int64_t), visit_bool(bool),
+   *  visit_double(double), visit_string(const std::string&),
+   *  visit_struct(const Struct&), visit_array(const Array&),
+   *  visit_base64(const Binary_data&), visit_datetime(const Date_time&)
+   *  and visit_other(const Value_type&), which receives objects of
+   *  Value_type::OTHER kind. Serializers use it, the virtual
+   *  Value_type_visitor remains for user extensions.
+   */
+  template <class Visitor>
+  void visit_static(Visitor&) const;
+
+  //! Visit content of Value_type object without virtual calls.
+  //! \see visit_static()
+  template <class Visitor>
+  static void visit_static(const Value_type&, Visitor&);
+
   static void set_default_int(int);
   static Int* get_default_int();
   static void drop_default_int();
@@ -128,9 +206,134 @@ public:
   static void omit_string_tag_in_responses(bool);
   static bool omit_string_tag_in_responses();
 
+  //! Make parser keep elements packed for arrays which elements
+  //! are all of the same type: int, i8, double or boolean.
+  //! Such arrays are still regular Array objects. \see Array::packed()
+  static void pack_numeric_arrays(bool);
+  static bool pack_numeric_arrays();
+
+  //! Serialize arrays of at least min_array_size elements in parallel
+  //! by specified number of extra threads. Zero threads turns it off (default).
+  static void set_parallel_serialization(unsigned threads, size_t min_array_size = 10000);
+
 private:
   template <class T> T* cast() const;
   template <class T> bool can_cast() const;
+
+  //! Cast for modification. Makes private copy of shared object.
+  template <class T> T* mutable_cast();
+
+  static Value_type* share( Value_type* );
+  static void release( Value_type* );
+
+  void set_string( const char*, size_t );
+  void swap( Value& ) throw();
+};
+
+template <class Visitor>
+inline void Value::visit_static(Visitor& vis) const
+{
+  switch (storage) {
+  case NIL:
+    vis.visit_nil();
+    break;
+
+  case INT:
+    vis.visit_int(data.int_value);
+    break;
+
+  case INT64:
+    vis.visit_int64(data.int64_value);
+    break;
+
+  case BOOL:
+    vis.visit_bool(data.bool_value);
+    break;
+
+  case DOUBLE:
+    vis.visit_double(data.double_value);
+    break;
+
+  case SHORT_STRING:
+    vis.visit_string(std::string(data.str_value, str_len));
+    break;
+
+  default:
+    visit_static(*data.value, vis);
+  }
+}
+
+template <class Visitor>
+inline void Value::visit_static(const Value_type& v, Visitor& vis)
+{
+  switch (v.kind()) {
+  case Value_type::NIL:
+    vis.visit_nil();
+    break;
+
+  case Value_type::INT:
+    vis.visit_int(static_cast<const Int&>(v).value());
+    break;
+
+  case Value_type::INT64:
+    vis.visit_int64(static_cast<const Int64&>(v).value());
+    break;
+
+  case Value_type::BOOL:
+    vis.visit_bool(static_cast<const Bool&>(v).value());
+    break;
+
+  case Value_type::DOUBLE:
+    vis.visit_double(static_cast<const Double&>(v).value());
+    break;
+
+  case Value_type::STRING:
+    vis.visit_string(static_cast<const String&>(v).value());
+    break;
+
+  case Value_type::ARRAY:
+    vis.visit_array(static_cast<const Array&>(v));
+    break;
+
+  case Value_type::STRUCT:
+    vis.visit_struct(static_cast<const Struct&>(v));
+    break;
+
+  case Value_type::BASE64:
+    vis.visit_base64(static_cast<const Binary_data&>(v));
+    break;
+
+  case Value_type::DATETIME:
+    vis.visit_datetime(static_cast<const Date_time&>(v));
+    break;
+
+  default:
+    vis.visit_other(v);
+  }
+}
+
+inline bool operator ==( const Value& a, const Value& b )
+{
+  return a.equals(b);
+}
+
+inline bool operator !=( const Value& a, const Value& b )
+{
+  return !a.equals(b);
+}
+
+//! Makes Value usable with boost::hash and boost::unordered containers.
+inline size_t hash_value( const Value& v )
+{
+  return v.hash();
+}
+
+//! Hash function object for hash-based containers.
+struct Value_hash {
+  size_t operator ()( const Value& v ) const
+  {
+    return v.hash();
+  }
 };
 
 class XmlBuilder;
@@ -0,0 +1,125 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include "value_arena.h"
+
+#include <boost/cstdint.hpp>
+#include <boost/thread/tss.hpp>
+#include <new>
+
+namespace iqxmlrpc {
+
+namespace {
+
+void keep_arena(Value_arena*)
+{
+}
+
+boost::thread_specific_ptr<Value_arena> current_arena(keep_arena);
+
+// Precedes every node to tell where it was allocated.
+// Union keeps the node properly aligned.
+union Node_header {
+  Value_arena* arena;
+  double d;
+  boost::int64_t i;
+};
+
+inline size_t align(size_t sz)
+{
+  const size_t a = sizeof(Node_header);
+  return (sz + a - 1) / a * a;
+}
+
+} // anonymous namespace
+
+
+Value_arena::Scope::Scope( Value_arena* arena ):
+  prev_(current_arena.get())
+{
+  current_arena.reset(arena);
+}
+
+Value_arena::Scope::~Scope()
+{
+  current_arena.reset(prev_);
+}
+
+
+Value_arena::Value_arena( size_t block_size ):
+  block_size_(align(block_size)),
+  capacity_(0),
+  pos_(0),
+  end_(0)
+{
+}
+
+Value_arena::~Value_arena()
+{
+  for (size_t i = 0; i < blocks_.size(); ++i)
+    ::operator delete(blocks_[i]);
+}
+
+char* Value_arena::add_block( size_t sz )
+{
+  blocks_.reserve(blocks_.size() + 1);
+  char* block = static_cast<char*>(::operator new(sz));
+  blocks_.push_back(block);
+  capacity_ += sz;
+  return block;
+}
+
+void* Value_arena::allocate( size_t sz )
+{
+  sz = align(sz);
+
+  // Large pieces get blocks of their own not to waste current one.
+  if (sz > block_size_ / 4)
+    return add_block(sz);
+
+  if (static_cast<size_t>(end_ - pos_) < sz)
+  {
+    pos_ = add_block(block_size_);
+    end_ = pos_ + block_size_;
+  }
+
+  void* p = pos_;
+  pos_ += sz;
+  return p;
+}
+
+Value_arena* Value_arena::current()
+{
+  return current_arena.get();
+}
+
+void* Value_arena::allocate_node( size_t sz )
+{
+  Value_arena* arena = current();
+  sz += sizeof(Node_header);
+
+  Node_header* h = static_cast<Node_header*>(
+    arena ? arena->allocate(sz) : ::operator new(sz));
+
+  h->arena = arena;
+  return h + 1;
+}
+
+void Value_arena::release_node( void* p )
+{
+  if (!p)
+    return;
+
+  Node_header* h = static_cast<Node_header*>(p) - 1;
+  if (!h->arena)
+    ::operator delete(h);
+}
+
+bool Value_arena::is_arena_node( const void* p )
+{
+  return (static_cast<const Node_header*>(p) - 1)->arena != 0;
+}
+
+} // namespace iqxmlrpc
+
+// vim:ts=2:sw=2:et
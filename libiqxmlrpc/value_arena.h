@@ -0,0 +1,68 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_value_arena_h_
+#define _iqxmlrpc_value_arena_h_
+
+#include "api_export.h"
+
+#include <boost/utility.hpp>
+#include <vector>
+
+namespace iqxmlrpc {
+
+//! Monotonic memory region for Value trees.
+/*! While a Value_arena::Scope is active in a thread, every Value and
+ *  Value_type created by this thread is placed into the arena.
+ *  Deleting such objects runs their destructors but does not free
+ *  memory: the whole region is released at once when arena is destroyed.
+ *  Values created without active scope are allocated on the heap,
+ *  so trees may be mixed freely.
+ *
+ *  Arena must outlive all the values allocated in it.
+ *  It is not thread-safe: only one thread may use it at a time.
+ */
+class LIBIQXMLRPC_API Value_arena: boost::noncopyable {
+public:
+  //! Makes arena current for calling thread until the scope ends.
+  class LIBIQXMLRPC_API Scope: boost::noncopyable {
+  public:
+    explicit Scope( Value_arena* );
+    ~Scope();
+
+  private:
+    Value_arena* prev_;
+  };
+
+  explicit Value_arena( size_t block_size = 64*1024 );
+  ~Value_arena();
+
+  void* allocate( size_t );
+
+  //! Total size of memory taken from the heap.
+  size_t capacity() const { return capacity_; }
+
+  //! Current arena of calling thread or NULL.
+  static Value_arena* current();
+
+  //! Allocation functions for Value and Value_type.
+  static void* allocate_node( size_t );
+  static void release_node( void* );
+
+  //! Checks if object created by allocate_node() lives in an arena.
+  static bool is_arena_node( const void* );
+
+private:
+  char* add_block( size_t );
+
+  size_t block_size_;
+  size_t capacity_;
+  std::vector<char*> blocks_;
+  char* pos_;
+  char* end_;
+};
+
+} // namespace iqxmlrpc
+
+#endif
+// vim:ts=2:sw=2:et
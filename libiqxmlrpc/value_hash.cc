@@ -0,0 +1,396 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#include <algorithm>
+#include <string.h>
+#include <boost/functional/hash.hpp>
+
+#include "value_hash.h"
+
+namespace iqxmlrpc {
+
+namespace {
+
+template <class T>
+inline size_t scalar_hash(Value_type::Kind k, const T& x)
+{
+  size_t seed = k;
+  boost::hash_combine(seed, x);
+  return seed;
+}
+
+inline size_t bytes_hash(Value_type::Kind k, const char* s, size_t n)
+{
+  size_t seed = k;
+  boost::hash_range(seed, s, s + n);
+  return seed;
+}
+
+//! Packed elements hash as regular values.
+template <class T>
+bool packed_hash(const Array& arr, size_t& h)
+{
+  const Packed_array<T>* a = arr.packed_as<T>();
+  if (!a)
+    return false;
+
+  const Value_type::Kind k = static_cast<Value_type::Kind>(Scalar_kind<T>::value);
+  Value_hasher hasher(Value_type::ARRAY);
+  for (size_t i = 0; i < a->size(); ++i)
+    hasher.add_hash(scalar_hash(k, (*a)[i]));
+
+  h = hasher.hash();
+  return true;
+}
+
+size_t other_hash(const Value_type& v)
+{
+  if (const Raw_xml_value* r = dynamic_cast<const Raw_xml_value*>(&v))
+    return bytes_hash(Value_type::OTHER, r->xml().data(), r->xml().size());
+
+  // Generated and user defined values are equal to own copies only.
+  boost::hash<const void*> ptr_hash;
+  if (const Generated_array* g = dynamic_cast<const Generated_array*>(&v))
+    return ptr_hash(&g->generator());
+
+  return ptr_hash(&v);
+}
+
+template <class T>
+bool packed_equal(const Array& a, const Array& b, bool& result)
+{
+  const Packed_array<T>* pa = a.packed_as<T>();
+  const Packed_array<T>* pb = b.packed_as<T>();
+  if (!pa || !pb)
+    return false;
+
+  result = std::equal(pa->data(), pa->data() + pa->size(), pb->data());
+  return true;
+}
+
+bool arrays_equal(const Array& a, const Array& b)
+{
+  if (a.size() != b.size())
+    return false;
+
+  size_t ha = Value_hasher::cached_hash(a);
+  size_t hb = Value_hasher::cached_hash(b);
+  if (ha && hb && ha != hb)
+    return false;
+
+  bool r = false;
+  if (packed_equal<int>(a, b, r) || packed_equal<int64_t>(a, b, r) ||
+      packed_equal<double>(a, b, r) || packed_equal<bool>(a, b, r))
+  {
+    return r;
+  }
+
+  return std::equal(a.begin(), a.end(), b.begin());
+}
+
+bool structs_equal(const Struct& a, const Struct& b)
+{
+  if (a.size() != b.size())
+    return false;
+
+  size_t ha = Value_hasher::cached_hash(a);
+  size_t hb = Value_hasher::cached_hash(b);
+  if (ha && hb && ha != hb)
+    return false;
+
+  // Members are sorted by name.
+  typedef Struct::const_iterator CI;
+  for (CI i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j)
+  {
+    if (i->first != j->first || *i->second != *j->second)
+      return false;
+  }
+
+  return true;
+}
+
+bool others_equal(const Value_type& a, const Value_type& b)
+{
+  const Raw_xml_value* ra = dynamic_cast<const Raw_xml_value*>(&a);
+  const Raw_xml_value* rb = dynamic_cast<const Raw_xml_value*>(&b);
+  if (ra && rb)
+    return ra->xml() == rb->xml();
+
+  const Generated_array* ga = dynamic_cast<const Generated_array*>(&a);
+  const Generated_array* gb = dynamic_cast<const Generated_array*>(&b);
+  return ga && gb && &ga->generator() == &gb->generator();
+}
+
+template <class T>
+inline bool scalars_equal(const Value_type& a, const Value_type& b)
+{
+  return static_cast<const T&>(a).value() == static_cast<const T&>(b).value();
+}
+
+bool nodes_equal(const Value_type& a, const Value_type& b)
+{
+  if (&a == &b)
+    return true;
+
+  if (a.kind() != b.kind() || a.kind() == Value_type::OTHER)
+    return others_equal(a, b);
+
+  switch (a.kind()) {
+  case Value_type::NIL:
+    return true;
+
+  case Value_type::INT:
+    return scalars_equal<Int>(a, b);
+
+  case Value_type::INT64:
+    return scalars_equal<Int64>(a, b);
+
+  case Value_type::BOOL:
+    return scalars_equal<Bool>(a, b);
+
+  case Value_type::DOUBLE:
+    return scalars_equal<Double>(a, b);
+
+  case Value_type::STRING:
+    return scalars_equal<String>(a, b);
+
+  case Value_type::ARRAY:
+    return arrays_equal(static_cast<const Array&>(a), static_cast<const Array&>(b));
+
+  case Value_type::STRUCT:
+    return structs_equal(static_cast<const Struct&>(a), static_cast<const Struct&>(b));
+
+  case Value_type::BASE64:
+    {
+      const Binary_data& ba = static_cast<const Binary_data&>(a);
+      const Binary_data& bb = static_cast<const Binary_data&>(b);
+      return ba.size() == bb.size() && !memcmp(ba.data(), bb.data(), ba.size());
+    }
+
+  case Value_type::DATETIME:
+    return static_cast<const Date_time&>(a).to_string() ==
+      static_cast<const Date_time&>(b).to_string();
+
+  default:
+    return false;
+  }
+}
+
+} // anonymous namespace
+
+//
+// Value_hasher
+//
+
+Value_hasher::Value_hasher(Value_type::Kind k):
+  seed_(0),
+  kind_(k),
+  valid_(true)
+{
+}
+
+void Value_hasher::add(const Value& v)
+{
+  add_hash(v.hash());
+}
+
+void Value_hasher::add(const std::string& name, const Value& v)
+{
+  size_t h = bytes_hash(Value_type::STRING, name.data(), name.size());
+  boost::hash_combine(h, v.hash());
+  seed_ += h;
+}
+
+void Value_hasher::add_hash(size_t h)
+{
+  boost::hash_combine(seed_, h);
+}
+
+size_t Value_hasher::hash() const
+{
+  size_t h = kind_;
+  boost::hash_combine(h, seed_);
+  return h ? h : 1;
+}
+
+void Value_hasher::store(Array& a) const
+{
+  a.hash_ = valid_ ? hash() : 0;
+}
+
+void Value_hasher::store(Struct& s) const
+{
+  s.hash_ = valid_ ? hash() : 0;
+}
+
+size_t Value_hasher::cached_hash(const Value_type& v)
+{
+  if (!v.shareable_)
+    return 0;
+
+  switch (v.kind()) {
+  case Value_type::ARRAY:
+    return static_cast<const Array&>(v).hash_;
+
+  case Value_type::STRUCT:
+    return static_cast<const Struct&>(v).hash_;
+
+  default:
+    return 0;
+  }
+}
+
+size_t Value_hasher::node_hash(const Value_type& v)
+{
+  switch (v.kind()) {
+  case Value_type::NIL:
+    return Value_type::NIL;
+
+  case Value_type::INT:
+    return scalar_hash(Value_type::INT, static_cast<const Int&>(v).value());
+
+  case Value_type::INT64:
+    return scalar_hash(Value_type::INT64, static_cast<const Int64&>(v).value());
+
+  case Value_type::BOOL:
+    return scalar_hash(Value_type::BOOL, static_cast<const Bool&>(v).value());
+
+  case Value_type::DOUBLE:
+    return scalar_hash(Value_type::DOUBLE, static_cast<const Double&>(v).value());
+
+  case Value_type::STRING:
+    {
+      const std::string& s = static_cast<const String&>(v).value();
+      return bytes_hash(Value_type::STRING, s.data(), s.size());
+    }
+
+  case Value_type::ARRAY:
+    {
+      size_t h = cached_hash(v);
+      if (h)
+        return h;
+
+      const Array& a = static_cast<const Array&>(v);
+      if (packed_hash<int>(a, h) || packed_hash<int64_t>(a, h) ||
+          packed_hash<double>(a, h) || packed_hash<bool>(a, h))
+      {
+        return h;
+      }
+
+      Value_hasher hasher(Value_type::ARRAY);
+      for (Array::const_iterator i = a.begin(); i != a.end(); ++i)
+        hasher.add(*i);
+
+      return hasher.hash();
+    }
+
+  case Value_type::STRUCT:
+    {
+      if (size_t h = cached_hash(v))
+        return h;
+
+      const Struct& s = static_cast<const Struct&>(v);
+      Value_hasher hasher(Value_type::STRUCT);
+      for (Struct::const_iterator i = s.begin(); i != s.end(); ++i)
+        hasher.add(i->first, *i->second);
+
+      return hasher.hash();
+    }
+
+  case Value_type::BASE64:
+    {
+      const Binary_data& b = static_cast<const Binary_data&>(v);
+      return bytes_hash(Value_type::BASE64, b.data(), b.size());
+    }
+
+  case Value_type::DATETIME:
+    {
+      const std::string& s = static_cast<const Date_time&>(v).to_string();
+      return bytes_hash(Value_type::DATETIME, s.data(), s.size());
+    }
+
+  default:
+    return other_hash(v);
+  }
+}
+
+//
+// Value
+//
+
+size_t Value::hash() const
+{
+  switch (storage) {
+  case NIL:
+    return Value_type::NIL;
+
+  case INT:
+    return scalar_hash(Value_type::INT, data.int_value);
+
+  case INT64:
+    return scalar_hash(Value_type::INT64, data.int64_value);
+
+  case BOOL:
+    return scalar_hash(Value_type::BOOL, data.bool_value);
+
+  case DOUBLE:
+    return scalar_hash(Value_type::DOUBLE, data.double_value);
+
+  case SHORT_STRING:
+    return bytes_hash(Value_type::STRING, data.str_value, str_len);
+
+  default:
+    return data.value ? Value_hasher::node_hash(*data.value) : 0;
+  }
+}
+
+// Scalars are always kept inline and strings are inline if they are
+// short enough, so values of different storage are never equal.
+bool Value::equals( const Value& v ) const
+{
+  if (storage != v.storage)
+    return false;
+
+  switch (storage) {
+  case NIL:
+    return true;
+
+  case INT:
+    return data.int_value == v.data.int_value;
+
+  case INT64:
+    return data.int64_value == v.data.int64_value;
+
+  case BOOL:
+    return data.bool_value == v.data.bool_value;
+
+  case DOUBLE:
+    return data.double_value == v.data.double_value;
+
+  case SHORT_STRING:
+    return str_len == v.str_len && !memcmp(data.str_value, v.data.str_value, str_len);
+
+  default:
+    if (!data.value || !v.data.value)
+      return data.value == v.data.value;
+
+    return nodes_equal(*data.value, *v.data.value);
+  }
+}
+
+//
+// Free functions
+//
+
+size_t call_hash(const std::string& method, const std::vector<Value>& params)
+{
+  size_t h = boost::hash_value(method);
+  for (std::vector<Value>::const_iterator i = params.begin(); i != params.end(); ++i)
+    boost::hash_combine(h, i->hash());
+
+  return h;
+}
+
+} // namespace iqxmlrpc
+
+// vim:ts=2:sw=2:et
@@ -0,0 +1,61 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+#ifndef _iqxmlrpc_value_hash_h_
+#define _iqxmlrpc_value_hash_h_
+
+#include "value.h"
+
+#include <vector>
+
+namespace iqxmlrpc {
+
+//! Accumulates hash of array elements or struct members.
+/*! Parser feeds it with values as they are built and caches
+ *  the result in nodes, so Value::hash() of parsed arrays and
+ *  structs takes constant time. */
+class Value_hasher {
+public:
+  explicit Value_hasher(Value_type::Kind);
+
+  //! Add next array element.
+  void add(const Value&);
+
+  //! Add struct member. Order of members does not matter.
+  void add(const std::string& name, const Value&);
+
+  //! Add next array element by its hash.
+  void add_hash(size_t);
+
+  //! Never returns zero, which marks unknown hash in nodes.
+  size_t hash() const;
+
+  //! Content was changed in a way the hash can not follow,
+  //! e.g. struct member was replaced. Nothing is cached then.
+  void invalidate() { valid_ = false; }
+
+  //! Cache current hash in node which was not given out yet.
+  void store(Array&) const;
+  void store(Struct&) const;
+
+  //! Hash of node content. Cached hash is used while node
+  //! is shareable, i.e. no mutable reference to it was given out.
+  static size_t node_hash(const Value_type&);
+
+  //! Cached hash of array or struct, zero if unknown.
+  static size_t cached_hash(const Value_type&);
+
+private:
+  size_t seed_;
+  size_t kind_;
+  bool valid_;
+};
+
+//! Hash of method name and parameters for interceptors which
+//! look for identical calls.
+size_t call_hash(const std::string& method, const std::vector<Value>& params);
+
+} // namespace iqxmlrpc
+
+#endif
+// vim:ts=2:sw=2:et
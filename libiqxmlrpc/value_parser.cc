@@ -2,9 +2,13 @@
 //  Copyright (C) 2011 Anton Dedov
 
 #include <stdexcept>
+#include <typeinfo>
 #include <boost/lexical_cast.hpp>
 #include "except.h"
+#include "params_visitor.h"
+#include "value_hash.h"
 #include "value_parser.h"
+#include "value_type_visitor.h"
 
 namespace iqxmlrpc {
 
@@ -20,7 +24,8 @@ public:
   StructBuilder(Parser& parser):
     ValueBuilderBase(parser),
     state_(parser, NONE),
-    value_(0)
+    value_(0),
+    hasher_(Value_type::STRUCT)
   {
     static const StateMachine::StateTransition trans[] = {
       { NONE, MEMBER, "member" },
@@ -30,6 +35,7 @@ public:
     };
     state_.set_transitions(trans);
     retval.reset(proxy_ = new Struct());
+    hasher_.store(*proxy_);
   }
 
 private:
@@ -69,9 +75,20 @@ private:
         throw XML_RPC_violation(parser_.context());
       }
 
-      Value_ptr v(new Value(value_));
-      proxy_->insert(name_, v);
+      // Members are sorted once at the end of struct.
+      Value* val = new Value(value_);
+      Value_ptr v(val);
+      proxy_->append_unsorted(name_, v);
+
+      // Hash is computed as members come, it does not depend on order.
+      hasher_.add(name_, *val);
       state_.set_state(NONE);
+
+    } else if (tagname == "struct") {
+      if (!proxy_->sort_members())
+        hasher_.invalidate();
+
+      hasher_.store(*proxy_);
     }
   }
 
@@ -79,14 +96,45 @@ private:
   std::string name_;
   Value_type* value_;
   Struct* proxy_;
+  Value_hasher hasher_;
 };
 
+//! Creates packed storage suitable for the element, if any.
+Packed_array_base* create_packed(const Value_type* v)
+{
+  const std::type_info& t = typeid(*v);
+
+  if (t == typeid(Int))
+    return new Int_array();
+  if (t == typeid(Int64))
+    return new Int64_array();
+  if (t == typeid(Double))
+    return new Double_array();
+  if (t == typeid(Bool))
+    return new Bool_array();
+
+  return 0;
+}
+
+template <class T>
+bool append_packed(Packed_array_base* a, const Value_type* v)
+{
+  if (typeid(*v) != typeid(Scalar<T>) || typeid(*a) != typeid(Packed_array<T>))
+    return false;
+
+  static_cast<Packed_array<T>*>(a)->push_back(static_cast<const Scalar<T>*>(v)->value());
+  return true;
+}
+
 class ArrayBuilder: public ValueBuilderBase {
 public:
   ArrayBuilder(Parser& parser):
     ValueBuilderBase(parser),
     state_(parser, NONE),
-    proxy_(0)
+    proxy_(0),
+    packed_(0),
+    first_(Value::pack_numeric_arrays()),
+    hasher_(Value_type::ARRAY)
   {
     static const StateMachine::StateTransition trans[] = {
       { NONE, DATA, "data" },
@@ -96,6 +144,7 @@ public:
     };
     state_.set_transitions(trans);
     retval.reset(proxy_ = new Array());
+    hasher_.store(*proxy_);
   }
 
 private:
@@ -111,13 +160,176 @@ private:
     if (state_.change(tagname) == VALUES) {
       Value_type* tmp = sub_build<Value_type*, ValueBuilder>();
       tmp = tmp ? tmp : new String("");
-      Value_ptr v(new Value(tmp));
+
+      if (first_) {
+        first_ = false;
+        if ((packed_ = create_packed(tmp)))
+          retval.reset(proxy_ = new Array(packed_));
+      }
+
+      if (packed_) {
+        if (append_packed<int>(packed_, tmp) ||
+            append_packed<int64_t>(packed_, tmp) ||
+            append_packed<double>(packed_, tmp) ||
+            append_packed<bool>(packed_, tmp))
+        {
+          hasher_.add_hash(Value_hasher::node_hash(*tmp));
+          hasher_.store(*proxy_);
+          delete tmp;
+          return;
+        }
+
+        // Elements of different types met, array unpacks itself
+        // on modification.
+        packed_ = 0;
+      }
+
+      Value* val = new Value(tmp);
+      Value_ptr v(val);
       proxy_->push_back(v);
+      hasher_.add(*val);
+      hasher_.store(*proxy_);
     }
   }
 
   StateMachine state_;
   Array* proxy_;
+  Packed_array_base* packed_;
+  bool first_;
+  Value_hasher hasher_;
+};
+
+class StructStreamer: public BuilderBase {
+public:
+  StructStreamer(Parser& parser, Params_visitor& visitor):
+    BuilderBase(parser),
+    state_(parser, NONE),
+    visitor_(visitor)
+  {
+    static const StateMachine::StateTransition trans[] = {
+      { NONE, MEMBER, "member" },
+      { MEMBER, NAME_READ, "name" },
+      { NAME_READ, VALUE_READ, "value" },
+      { 0, 0, 0 }
+    };
+    state_.set_transitions(trans);
+  }
+
+private:
+  enum State {
+    NONE,
+    MEMBER,
+    NAME_READ,
+    VALUE_READ,
+  };
+
+  virtual void
+  do_visit_element(const std::string& tagname)
+  {
+    switch (state_.change(tagname)) {
+    case NAME_READ:
+      visitor_.visit_member(parser_.get_data());
+      break;
+
+    case VALUE_READ:
+      {
+        ValueStreamer s(parser_, visitor_);
+        s.stream();
+      }
+      break;
+
+    case MEMBER:
+      break;
+
+    default:
+      throw XML_RPC_violation(parser_.context());
+    }
+  }
+
+  virtual void
+  do_visit_element_end(const std::string& tagname)
+  {
+    if (tagname == "member") {
+      if (state_.get_state() != VALUE_READ) {
+        throw XML_RPC_violation(parser_.context());
+      }
+
+      state_.set_state(NONE);
+    }
+  }
+
+  StateMachine state_;
+  Params_visitor& visitor_;
+};
+
+class ArrayStreamer: public BuilderBase {
+public:
+  ArrayStreamer(Parser& parser, Params_visitor& visitor):
+    BuilderBase(parser),
+    state_(parser, NONE),
+    visitor_(visitor)
+  {
+    static const StateMachine::StateTransition trans[] = {
+      { NONE, DATA, "data" },
+      { DATA, VALUES, "value" },
+      { VALUES, VALUES, "value" },
+      { 0, 0, 0 }
+    };
+    state_.set_transitions(trans);
+  }
+
+private:
+  enum State {
+    NONE,
+    DATA,
+    VALUES
+  };
+
+  virtual void
+  do_visit_element(const std::string& tagname)
+  {
+    if (state_.change(tagname) == VALUES) {
+      ValueStreamer s(parser_, visitor_);
+      s.stream();
+    }
+  }
+
+  StateMachine state_;
+  Params_visitor& visitor_;
+};
+
+//! Passes scalar values to Params_visitor.
+class Scalar_to_params_visitor: public Value_type_visitor {
+public:
+  Scalar_to_params_visitor(Params_visitor& v):
+    visitor_(v) {}
+
+private:
+  void do_visit_value(const Value_type& v)
+  {
+    v.apply_visitor(*this);
+  }
+
+  void do_visit_nil()                         { visitor_.visit_nil(); }
+  void do_visit_int(int i)                    { visitor_.visit_int(i); }
+  void do_visit_int64(int64_t i)              { visitor_.visit_int64(i); }
+  void do_visit_double(double d)              { visitor_.visit_double(d); }
+  void do_visit_bool(bool b)                  { visitor_.visit_bool(b); }
+  void do_visit_string(const std::string& s)  { visitor_.visit_string(s); }
+  void do_visit_base64(const Binary_data& b)  { visitor_.visit_base64(b); }
+  void do_visit_datetime(const Date_time& d)  { visitor_.visit_datetime(d); }
+
+  void do_visit_struct(const Struct&)
+  {
+    throw Exception("Scalar_to_params_visitor: unexpected struct.");
+  }
+
+  void do_visit_array(const Array&)
+  {
+    throw Exception("Scalar_to_params_visitor: unexpected array.");
+  }
+
+  Params_visitor& visitor_;
 };
 
 } // anonymous namespace
@@ -136,25 +348,112 @@ enum ValueBuilderState {
   NIL
 };
 
+namespace {
+
+const StateMachine::StateTransition value_transitions[] = {
+  { VALUE,  STRING, "string" },
+  { VALUE,  INT,    "int" },
+  { VALUE,  INT,    "i4" },
+  { VALUE,  INT64,  "i8" },
+  { VALUE,  BOOL,   "boolean" },
+  { VALUE,  DOUBLE, "double" },
+  { VALUE,  BINARY, "base64" },
+  { VALUE,  TIME,   "dateTime.iso8601" },
+  { VALUE,  STRUCT, "struct" },
+  { VALUE,  ARRAY,  "array" },
+  { VALUE,  NIL,    "nil" },
+  { 0, 0, 0 }
+};
+
+//! Creates scalar from element's text. Returns 0 if state is not a scalar one.
+Value_type*
+scalar_from_text(int state, const std::string& text)
+{
+  using boost::lexical_cast;
+
+  switch (state) {
+  case VALUE:
+  case STRING:
+    return new String(text);
+
+  case INT:
+    return new Int(lexical_cast<int>(text));
+
+  case INT64:
+    return new Int64(lexical_cast<int64_t>(text));
+
+  case BOOL:
+    return new Bool(lexical_cast<int>(text) != 0);
+
+  case DOUBLE:
+    return new Double(lexical_cast<double>(text));
+
+  case BINARY:
+    return Binary_data::from_base64(text);
+
+  case TIME:
+    return new Date_time(text);
+
+  default:
+    return 0;
+  }
+}
+
+//! Creates scalar from element without text.
+//! Returns 0 if such element is not allowed.
+Value_type*
+scalar_from_empty(int state)
+{
+  switch (state) {
+  case VALUE:
+  case STRING:
+    return new String("");
+
+  case INT:
+    return Value::get_default_int();
+
+  case INT64:
+    {
+      std::auto_ptr<Int64> default_int64(Value::get_default_int64());
+      return default_int64.get() ? new Int64(default_int64->value()) : 0;
+    }
+
+  case BINARY:
+    return Binary_data::from_data("");
+
+  case NIL:
+    return new Nil();
+
+  default:
+    return 0;
+  }
+}
+
+} // anonymous namespace
+
+Value_type*
+build_scalar_value(const std::string& type, const std::string* text)
+{
+  int state = VALUE;
+
+  if (!type.empty()) {
+    const StateMachine::StateTransition* t = value_transitions;
+    for (; t->tag && type != t->tag; ++t) {}
+
+    if (!t->tag)
+      return 0;
+
+    state = t->new_state;
+  }
+
+  return text ? scalar_from_text(state, *text) : scalar_from_empty(state);
+}
+
 ValueBuilder::ValueBuilder(Parser& parser):
   ValueBuilderBase(parser, true),
   state_(parser, VALUE)
 {
-  static const StateMachine::StateTransition trans[] = {
-    { VALUE,  STRING, "string" },
-    { VALUE,  INT,    "int" },
-    { VALUE,  INT,    "i4" },
-    { VALUE,  INT64,  "i8" },
-    { VALUE,  BOOL,   "boolean" },
-    { VALUE,  DOUBLE, "double" },
-    { VALUE,  BINARY, "base64" },
-    { VALUE,  TIME,   "dateTime.iso8601" },
-    { VALUE,  STRUCT, "struct" },
-    { VALUE,  ARRAY,  "array" },
-    { VALUE,  NIL,    "nil" },
-    { 0, 0, 0 }
-  };
-  state_.set_transitions(trans);
+  state_.set_transitions(value_transitions);
 }
 
 void
@@ -162,14 +461,17 @@ ValueBuilder::do_visit_element(const std::string& tagname)
 {
   switch (state_.change(tagname)) {
   case STRUCT:
-    retval.reset(sub_build<Value_type*, StructBuilder>(true));
+    build_struct();
+    want_exit();
     break;
 
   case ARRAY:
-    retval.reset(sub_build<Value_type*, ArrayBuilder>(true));
+    build_array();
+    want_exit();
     break;
 
   case NIL:
+    // do not exit until the end of <nil/> element is consumed
     retval.reset(new Nil());
     break;
 
@@ -177,9 +479,18 @@ ValueBuilder::do_visit_element(const std::string& tagname)
     // wait for text within <i4>...</i4>, etc...
     break;
   }
+}
 
-  if (retval.get())
-    want_exit();
+void
+ValueBuilder::build_struct()
+{
+  retval.reset(sub_build<Value_type*, StructBuilder>(true));
+}
+
+void
+ValueBuilder::build_array()
+{
+  retval.reset(sub_build<Value_type*, ArrayBuilder>(true));
 }
 
 void
@@ -188,77 +499,95 @@ ValueBuilder::do_visit_element_end(const std::string&)
   if (retval.get())
     return;
 
-  std::auto_ptr<Int> default_int(Value::get_default_int());
-  std::auto_ptr<Int64> default_int64(Value::get_default_int64());
+  retval.reset(scalar_from_empty(state_.get_state()));
+  if (!retval.get())
+    throw XML_RPC_violation(parser_.context());
+}
 
-  switch (state_.get_state()) {
-  case VALUE:
-  case STRING:
-    retval.reset(new String(""));
-    break;
+void
+ValueBuilder::do_visit_text(const std::string& text)
+{
+  if (state_.get_state() == VALUE)
+    want_exit();
 
-  case INT:
-    if (default_int.get()) {
-      retval.reset(default_int.release());
-      break;
-    }
+  retval.reset(scalar_from_text(state_.get_state(), text));
+  if (!retval.get())
     throw XML_RPC_violation(parser_.context());
+}
 
-  case INT64:
-    if (default_int64.get()) {
-      retval.reset(new Int64(default_int64.release()->value()));
-      break;
-    }
-    throw XML_RPC_violation(parser_.context());
+//
+// ValueElementBuilder
+//
 
-  case BINARY:
-    retval.reset(Binary_data::from_data(""));
-    break;
+enum ValueElementBuilderState {
+  NONE,
+  ELEMENT
+};
 
-  default:
-    throw XML_RPC_violation(parser_.context());
-  }
+ValueElementBuilder::ValueElementBuilder(Parser& parser):
+  ValueBuilderBase(parser),
+  state_(parser, NONE)
+{
+  static const StateMachine::StateTransition trans[] = {
+    { NONE, ELEMENT, "value" },
+    { 0, 0, 0 }
+  };
+  state_.set_transitions(trans);
 }
 
 void
-ValueBuilder::do_visit_text(const std::string& text)
+ValueElementBuilder::do_visit_element(const std::string& tagname)
 {
-  using boost::lexical_cast;
+  state_.change(tagname);
+  retval.reset(sub_build<Value_type*, ValueBuilder>(true));
+  want_exit();
+}
 
-  switch (state_.get_state()) {
-  case VALUE:
-    want_exit();
-  case STRING:
-    retval.reset(new String(text));
-    break;
+//
+// ValueStreamer
+//
 
-  case INT:
-    retval.reset(new Int(lexical_cast<int>(text)));
-    break;
+ValueStreamer::ValueStreamer(Parser& parser, Params_visitor& visitor):
+  ValueBuilder(parser),
+  visitor_(visitor),
+  streamed_(false)
+{
+}
 
-  case INT64:
-    retval.reset(new Int64(lexical_cast<int64_t>(text)));
-    break;
+void
+ValueStreamer::stream(bool flat)
+{
+  build(flat);
 
-  case BOOL:
-    retval.reset(new Bool(lexical_cast<int>(text) != 0));
-    break;
+  if (streamed_)
+    return;
 
-  case DOUBLE:
-    retval.reset(new Double(lexical_cast<double>(text)));
-    break;
+  std::auto_ptr<Value_type> v(result());
+  if (!v.get())
+    v.reset(new String(""));
 
-  case BINARY:
-    retval.reset(Binary_data::from_base64(text));
-    break;
+  Scalar_to_params_visitor scalar_visitor(visitor_);
+  scalar_visitor.visit_value(*v);
+}
 
-  case TIME:
-    retval.reset(new Date_time(text));
-    break;
+void
+ValueStreamer::build_struct()
+{
+  visitor_.visit_struct_begin();
+  StructStreamer s(parser_, visitor_);
+  s.build(true);
+  visitor_.visit_struct_end();
+  streamed_ = true;
+}
 
-  default:
-    throw XML_RPC_violation(parser_.context());
-  }
+void
+ValueStreamer::build_array()
+{
+  visitor_.visit_array_begin();
+  ArrayStreamer s(parser_, visitor_);
+  s.build(true);
+  visitor_.visit_array_end();
+  streamed_ = true;
 }
 
 } // namespace iqxmlrpc
@@ -9,6 +9,8 @@
 
 namespace iqxmlrpc {
 
+class Params_visitor;
+
 class ValueBuilderBase: public BuilderBase {
 public:
   ValueBuilderBase(Parser& parser, bool expect_text = false);
@@ -37,9 +39,57 @@ private:
   virtual void
   do_visit_text(const std::string&);
 
+  //! Called when <struct> tag is met.
+  virtual void
+  build_struct();
+
+  //! Called when <array> tag is met.
+  virtual void
+  build_array();
+
   StateMachine state_;
 };
 
+//! Builds value from standalone <value> element.
+class ValueElementBuilder: public ValueBuilderBase {
+public:
+  ValueElementBuilder(Parser& parser);
+
+private:
+  virtual void
+  do_visit_element(const std::string&);
+
+  StateMachine state_;
+};
+
+//! Parses single value and reports it to Params_visitor
+//! instead of building Value_type object.
+class ValueStreamer: public ValueBuilder {
+public:
+  ValueStreamer(Parser& parser, Params_visitor& visitor);
+
+  void
+  stream(bool flat = false);
+
+private:
+  virtual void
+  build_struct();
+
+  virtual void
+  build_array();
+
+  Params_visitor& visitor_;
+  bool streamed_;
+};
+
+//! Creates scalar the same way ValueBuilder does.
+/*! \param type name of element within <value>, empty for text right in it.
+ *  \param text text of the element, 0 if there is none.
+ *  \return 0 if type is unknown or requires text.
+ */
+Value_type*
+build_scalar_value(const std::string& type, const std::string* text);
+
 } // namespace iqxmlrpc
 
 #endif
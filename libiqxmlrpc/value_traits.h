@@ -0,0 +1,287 @@
+//  Libiqxmlrpc - an object-oriented XML-RPC solution.
+//  Copyright (C) 2011 Anton Dedov
+
+/*! \file */
+#ifndef _iqxmlrpc_value_traits_h_
+#define _iqxmlrpc_value_traits_h_
+
+#include "value.h"
+
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace iqxmlrpc {
+
+//! Conversion between native C++ types and Value.
+/*! Specializations provide:
+ *  - type_name(): XML-RPC type name as used by system.methodSignature;
+ *  - from_value(): conversion from Value, throws Value::Bad_cast
+ *    if value is of other type;
+ *  - to_value(): conversion to Value.
+ *
+ *  Specialize it to make own types usable with typed methods.
+ */
+template <class T>
+struct Value_traits;
+
+#define IQXMLRPC_SCALAR_TRAITS(T, name, getter) \
+template <> \
+struct Value_traits<T> { \
+  static const char* type_name() { return name; } \
+  static T from_value(const Value& v) { return v.getter(); } \
+  static Value to_value(const T& x) { return Value(x); } \
+};
+
+IQXMLRPC_SCALAR_TRAITS(int,         "int",              get_int)
+IQXMLRPC_SCALAR_TRAITS(int64_t,     "i8",               get_int64)
+IQXMLRPC_SCALAR_TRAITS(bool,        "boolean",          get_bool)
+IQXMLRPC_SCALAR_TRAITS(double,      "double",           get_double)
+IQXMLRPC_SCALAR_TRAITS(std::string, "string",           get_string)
+IQXMLRPC_SCALAR_TRAITS(Binary_data, "base64",           get_binary)
+IQXMLRPC_SCALAR_TRAITS(Date_time,   "dateTime.iso8601", get_datetime)
+
+#undef IQXMLRPC_SCALAR_TRAITS
+
+//! Pass-through for methods which inspect parameters themselves.
+template <>
+struct Value_traits<Value> {
+  static const char* type_name() { return "value"; }
+  static Value from_value(const Value& v) { return v; }
+  static Value to_value(const Value& x) { return x; }
+};
+
+template <>
+struct Value_traits<Array> {
+  static const char* type_name() { return "array"; }
+  static Array from_value(const Value& v) { return v.the_array(); }
+  static Value to_value(const Array& x) { return Value(x); }
+};
+
+template <>
+struct Value_traits<Struct> {
+  static const char* type_name() { return "struct"; }
+  static Struct from_value(const Value& v) { return v.the_struct(); }
+  static Value to_value(const Struct& x) { return Value(x); }
+};
+
+namespace detail {
+
+//! Copies packed elements of matching type. Other types are never packed.
+template <class T>
+inline bool unpack(const Value&, std::vector<T>&)
+{
+  return false;
+}
+
+template <class T>
+inline bool unpack_numeric(const Value& v, std::vector<T>& out)
+{
+  const Packed_array<T>* pa = v.the_array().packed_as<T>();
+  if (!pa)
+    return false;
+
+  out.assign(pa->data(), pa->data() + pa->size());
+  return true;
+}
+
+inline bool unpack(const Value& v, std::vector<int>& out)
+{
+  return unpack_numeric(v, out);
+}
+
+inline bool unpack(const Value& v, std::vector<int64_t>& out)
+{
+  return unpack_numeric(v, out);
+}
+
+inline bool unpack(const Value& v, std::vector<double>& out)
+{
+  return unpack_numeric(v, out);
+}
+
+inline bool unpack(const Value& v, std::vector<bool>& out)
+{
+  return unpack_numeric(v, out);
+}
+
+//! Makes array with packed elements for numeric types.
+template <class T>
+inline Value_type* pack(const std::vector<T>&)
+{
+  return 0;
+}
+
+template <class T>
+inline Value_type* pack_numeric(const std::vector<T>& x)
+{
+  if (x.empty())
+    return 0;
+
+  return new Array(new Packed_array<T>(&x[0], x.size()));
+}
+
+inline Value_type* pack(const std::vector<int>& x)
+{
+  return pack_numeric(x);
+}
+
+inline Value_type* pack(const std::vector<int64_t>& x)
+{
+  return pack_numeric(x);
+}
+
+inline Value_type* pack(const std::vector<double>& x)
+{
+  return pack_numeric(x);
+}
+
+//! std::vector<bool> has no contiguous storage to copy from.
+inline Value_type* pack(const std::vector<bool>& x)
+{
+  if (x.empty())
+    return 0;
+
+  return new Array(new Packed_array<bool>(x.begin(), x.end()));
+}
+
+} // namespace detail
+
+template <class T>
+struct Value_traits<std::vector<T> > {
+  static const char* type_name() { return "array"; }
+
+  static std::vector<T> from_value(const Value& v)
+  {
+    std::vector<T> retval;
+    if (detail::unpack(v, retval))
+      return retval;
+
+    const Array& a = v.the_array();
+    retval.reserve(a.size());
+    for (Array::const_iterator i = a.begin(); i != a.end(); ++i)
+      retval.push_back(Value_traits<T>::from_value(*i));
+
+    return retval;
+  }
+
+  static Value to_value(const std::vector<T>& x)
+  {
+    if (Value_type* packed = detail::pack(x))
+      return Value(packed);
+
+    Value retval = Array();
+    Array& a = retval.the_array();
+    typedef typename std::vector<T>::const_iterator CI;
+    for (CI i = x.begin(); i != x.end(); ++i)
+      a.push_back(Value_traits<T>::to_value(*i));
+
+    return retval;
+  }
+};
+
+template <class T>
+struct Value_traits<std::map<std::string, T> > {
+  static const char* type_name() { return "struct"; }
+
+  static std::map<std::string, T> from_value(const Value& v)
+  {
+    std::map<std::string, T> retval;
+    const Struct& s = v.the_struct();
+    for (Struct::const_iterator i = s.begin(); i != s.end(); ++i)
+      retval.insert(retval.end(),
+        std::make_pair(i->first, Value_traits<T>::from_value(*i->second)));
+
+    return retval;
+  }
+
+  static Value to_value(const std::map<std::string, T>& x)
+  {
+    Value retval = Struct();
+    Struct& s = retval.the_struct();
+    typedef typename std::map<std::string, T>::const_iterator CI;
+    for (CI i = x.begin(); i != x.end(); ++i)
+      s.insert(i->first, Value_traits<T>::to_value(i->second));
+
+    return retval;
+  }
+};
+
+//! Convert native value into Value. \see Value_traits
+template <class T>
+inline Value to_value(const T& x)
+{
+  return Value_traits<T>::to_value(x);
+}
+
+//! Convert Value into native type. \see Value_traits
+/*! \exception Value::Bad_cast
+ *  \exception Struct::No_field */
+template <class T>
+inline T value_cast(const Value& v)
+{
+  return Value_traits<T>::from_value(v);
+}
+
+namespace detail {
+
+template <class M>
+inline void get_member(const Struct& s, const char* name, M& m)
+{
+  m = Value_traits<M>::from_value(s[name]);
+}
+
+template <class M>
+inline void set_member(Struct& s, const char* name, const M& m)
+{
+  s.insert(name, Value_traits<M>::to_value(m));
+}
+
+} // namespace detail
+
+} // namespace iqxmlrpc
+
+#define IQXMLRPC_STRUCT_GET_MEMBER(r, data, member) \
+  ::iqxmlrpc::detail::get_member(s, BOOST_PP_STRINGIZE(member), x.member);
+
+#define IQXMLRPC_STRUCT_SET_MEMBER(r, data, member) \
+  ::iqxmlrpc::detail::set_member(s, BOOST_PP_STRINGIZE(member), x.member);
+
+//! Map C++ struct to XML-RPC struct with members of the same names.
+/*! Must be used in the global namespace with fully qualified type name.
+ *  Type must be default constructible and its members must have
+ *  Value_traits. Members of XML-RPC struct not listed here are ignored,
+ *  so with lazy responses they are not even decoded.
+ *  Missing members cause Struct::No_field exception.
+ *
+ *  E.g. IQXMLRPC_STRUCT(app::Point, (x)(y)(label))
+ */
+#define IQXMLRPC_STRUCT(Type, members) \
+namespace iqxmlrpc { \
+template <> \
+struct Value_traits<Type> { \
+  static const char* type_name() { return "struct"; } \
+\
+  static Type from_value(const Value& v) \
+  { \
+    const Struct& s = v.the_struct(); \
+    Type x; \
+    BOOST_PP_SEQ_FOR_EACH(IQXMLRPC_STRUCT_GET_MEMBER, _, members) \
+    return x; \
+  } \
+\
+  static Value to_value(const Type& x) \
+  { \
+    Value retval = Struct(); \
+    Struct& s = retval.the_struct(); \
+    BOOST_PP_SEQ_FOR_EACH(IQXMLRPC_STRUCT_SET_MEMBER, _, members) \
+    return retval; \
+  } \
+}; \
+}
+
+#endif
+// vim:ts=2:sw=2:et
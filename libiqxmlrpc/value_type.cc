@@ -3,15 +3,29 @@
 
 #include "value_type.h"
 
+#include "lazy_parser.h"
 #include "util.h"
 #include "value.h"
 #include "value_type_visitor.h"
 
 #include <boost/lexical_cast.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/tss.hpp>
 
 #include <algorithm>
+#include <memory>
 #include <string.h>
+#include <utility>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#include <iterator>
+#endif
 
 namespace iqxmlrpc {
 namespace type_names {
@@ -124,9 +138,39 @@ public:
 #endif
 
 
-Array::Array( const Array& other )
+Array::Array( const Array& other ):
+  Value_type(ARRAY),
+  packed_(0),
+  hash_(0)
+{
+  // Values created from packed elements are not copied.
+  if( other.packed_ )
+  {
+    packed_ = other.packed_->clone();
+    return;
+  }
+
+  if( !other.lazy_ )
+  {
+    std::for_each( other.begin(), other.end(), Array_inserter(&values) );
+    return;
+  }
+
+  // Elements which were not accessed yet are kept undecoded in copy.
+  boost::mutex::scoped_lock lk(other.lazy_->lock_);
+  lazy_.reset(other.lazy_->clone());
+
+  values.reserve(other.values.size());
+  for( Val_vector::const_iterator i = other.values.begin(); i != other.values.end(); ++i )
+    values.push_back( *i ? new Value(**i) : 0 );
+}
+
+
+Array::Array( Packed_array_base* p ):
+  Value_type(ARRAY),
+  packed_(p),
+  hash_(0)
 {
-  std::for_each( other.begin(), other.end(), Array_inserter(&values) );
 }
 
 
@@ -150,6 +194,9 @@ Array& Array::operator =( const Array& other )
 void Array::swap( Array& other) throw()
 {
   values.swap(other.values);
+  lazy_.swap(other.lazy_);
+  std::swap(packed_, other.packed_);
+  hash_ = other.hash_ = 0;
 }
 
 
@@ -173,10 +220,102 @@ void Array::apply_visitor(Value_type_visitor& v) const
 
 void Array::clear()
 {
+  hash_ = 0;
   util::delete_ptrs(values.begin(), values.end());
 
   // Clear and free memory
   std::vector<Value*>().swap( values );
+  lazy_.reset();
+
+  delete packed_;
+  packed_ = 0;
+}
+
+
+// --------------------------------------------------------------------------
+Generated_array::Generated_array( Array_generator* g ):
+  gen_(g)
+{
+}
+
+
+Value_type* Generated_array::clone() const
+{
+  return new Generated_array(*this);
+}
+
+
+const std::string& Generated_array::type_name() const
+{
+  return type_names::array_type_name;
+}
+
+
+void Generated_array::apply_visitor(Value_type_visitor& v) const
+{
+  v.visit_generated_array(*this);
+}
+
+
+namespace {
+
+//! Const access to packed array creates values once and may be done
+//! from several threads. Arrays are spread over a few locks, which are
+//! taken only until values are created.
+const size_t packed_locks_num = 16;
+boost::mutex packed_locks[packed_locks_num];
+
+inline boost::mutex& packed_lock( const void* p )
+{
+  return packed_locks[(reinterpret_cast<size_t>(p) / sizeof(void*)) % packed_locks_num];
+}
+
+} // anonymous namespace
+
+
+void Array::make_values() const
+{
+  if( !packed_ || packed_->materialized_ )
+    return;
+
+  boost::mutex::scoped_lock lk(packed_lock(this));
+  if( packed_->materialized_ )
+    return;
+
+  // Array may be shared, so values must not refer to request's arena.
+  Value_arena::Scope no_arena(0);
+  values.reserve( packed_->size() );
+  for( size_t i = values.size(); i < packed_->size(); ++i )
+    values.push_back( packed_->element(i) );
+
+  ++packed_->materialized_;
+}
+
+
+void Array::drop_packed()
+{
+  make_values();
+  delete packed_;
+  packed_ = 0;
+}
+
+
+Value& Array::at( size_t i ) const
+{
+  if( i >= size() )
+    throw Out_of_range();
+
+  if( packed_ )
+    make_values();
+
+  if( !lazy_ )
+    return *values[i];
+
+  boost::mutex::scoped_lock lk(lazy_->lock_);
+  if( !values[i] )
+    values[i] = lazy_->decode(i);
+
+  return *values[i];
 }
 
 
@@ -184,6 +323,7 @@ void Array::clear()
 // value_type.h and value.h
 void Array::push_back( Value_ptr v )
 {
+  unpack();
   values.push_back(v.release());
 }
 
@@ -192,31 +332,165 @@ void Array::push_back( Value_ptr v )
 // value_type.h and value.h
 void Array::push_back( const Value& v )
 {
+  unpack();
   values.push_back(new Value(v));
 }
 
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+void Array::push_back( Value&& v )
+{
+  Value_ptr p(new Value(std::move(v)));
+  push_back(p);
+}
+#endif
+
 
 // --------------------------------------------------------------------------
-#ifndef DOXYGEN_SHOULD_SKIP_THIS
-class Struct::Struct_inserter:
-  public std::unary_function<std::pair<std::string, Value*>,void>
+template <class T>
+Packed_array<T>::Packed_array():
+  data_(0),
+  size_(0),
+  capacity_(0)
 {
-  Struct::Value_stor* vs;
+}
 
-public:
-  Struct_inserter( Struct::Value_stor* v ): vs(v) {}
 
-  void operator ()( const std::pair<std::string, Value*>& vp )
+template <class T>
+Packed_array<T>::Packed_array( const T* first, size_t n ):
+  data_(n ? new T[n] : 0),
+  size_(n),
+  capacity_(n)
+{
+  std::copy(first, first + n, data_);
+}
+
+
+template <class T>
+Packed_array<T>::Packed_array( const Packed_array& other ):
+  Packed_array_base(),
+  data_(other.size_ ? new T[other.size_] : 0),
+  size_(other.size_),
+  capacity_(other.size_)
+{
+  std::copy(other.data_, other.data_ + size_, data_);
+}
+
+
+template <class T>
+Packed_array<T>::~Packed_array()
+{
+  delete[] data_;
+}
+
+
+template <class T>
+Packed_array<T>& Packed_array<T>::operator =( const Packed_array& other )
+{
+  Packed_array tmp(other);
+  tmp.swap(*this);
+  return *this;
+}
+
+
+template <class T>
+void Packed_array<T>::swap( Packed_array& other ) throw()
+{
+  std::swap(data_, other.data_);
+  std::swap(size_, other.size_);
+  std::swap(capacity_, other.capacity_);
+}
+
+
+template <class T>
+Packed_array<T>* Packed_array<T>::clone() const
+{
+  return new Packed_array<T>(*this);
+}
+
+
+template <class T>
+void Packed_array<T>::reserve( size_t n )
+{
+  if (n <= capacity_)
+    return;
+
+  T* tmp = new T[n];
+  std::copy(data_, data_ + size_, tmp);
+  delete[] data_;
+  data_ = tmp;
+  capacity_ = n;
+}
+
+
+template <class T>
+void Packed_array<T>::push_back( T t )
+{
+  if (size_ == capacity_)
+    reserve(capacity_ ? capacity_ * 2 : 16);
+
+  data_[size_++] = t;
+}
+
+
+template <class T>
+void Packed_array<T>::visit_element( size_t i, Value_type_visitor& v ) const
+{
+  Scalar<T> tmp(data_[i]);
+  v.visit_value(tmp);
+}
+
+
+template <class T>
+Value* Packed_array<T>::element( size_t i ) const
+{
+  return new Value(data_[i]);
+}
+
+
+template class Packed_array<int>;
+template class Packed_array<int64_t>;
+template class Packed_array<double>;
+template class Packed_array<bool>;
+
+
+// --------------------------------------------------------------------------
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+struct Member_less {
+  bool operator ()( const std::pair<std::string, Value*>& m, const std::string& key ) const
   {
-    vs->insert( std::make_pair(vp.first, new Value(*vp.second)) );
+    return m.first < key;
+  }
+
+  bool operator ()(
+    const std::pair<std::string, Value*>& a, const std::pair<std::string, Value*>& b ) const
+  {
+    return a.first < b.first;
   }
 };
 #endif
 
 
-Struct::Struct( const Struct& other )
+Struct::Struct( const Struct& other ):
+  Value_type(STRUCT),
+  hash_(0)
 {
-  std::for_each( other.begin(), other.end(), Struct_inserter(&values) );
+  values.reserve( other.values.size() );
+
+  if( !other.lazy_ )
+  {
+    for( Value_stor::const_iterator i = other.values.begin(); i != other.values.end(); ++i )
+      values.push_back( std::make_pair(i->first, new Value(*i->second)) );
+
+    return;
+  }
+
+  // Members which were not accessed yet are kept undecoded in copy.
+  boost::mutex::scoped_lock lk(other.lazy_->lock_);
+  lazy_.reset(other.lazy_->clone());
+
+  for( Value_stor::const_iterator i = other.values.begin(); i != other.values.end(); ++i )
+    values.push_back(
+      std::make_pair(i->first, i->second ? new Value(*i->second) : 0) );
 }
 
 
@@ -240,6 +514,8 @@ Struct::~Struct()
 void Struct::swap( Struct& other ) throw()
 {
   values.swap(other.values);
+  lazy_.swap(other.lazy_);
+  hash_ = other.hash_ = 0;
 }
 
 
@@ -267,47 +543,161 @@ size_t Struct::size() const
 }
 
 
+Struct::Value_stor::iterator Struct::lower_bound( const std::string& key ) const
+{
+  return std::lower_bound(values.begin(), values.end(), key, Member_less());
+}
+
+
+Struct::Value_stor::iterator Struct::lookup( const std::string& key ) const
+{
+  Value_stor::iterator i = lower_bound(key);
+  return i != values.end() && i->first == key ? i : values.end();
+}
+
+
 bool Struct::has_field( const std::string& f ) const
 {
-  return values.find(f) != values.end();
+  return lookup(f) != values.end();
 }
 
 
 const Value& Struct::operator []( const std::string& f ) const
 {
-  const_iterator i = values.find(f);
+  Value_stor::iterator i = lookup(f);
 
   if( i == values.end() )
     throw No_field( f );
 
+  decode(i);
   return (*i->second);
 }
 
 
 Value& Struct::operator []( const std::string& f )
 {
-  const_iterator i = values.find(f);
+  hash_ = 0;
+  Value_stor::iterator i = lookup(f);
 
   if( i == values.end() )
     throw No_field( f );
 
+  decode(i);
   return (*i->second);
 }
 
 
+void Struct::decode( Value_stor::iterator i ) const
+{
+  if( !lazy_ || i == values.end() )
+    return;
+
+  boost::mutex::scoped_lock lk(lazy_->lock_);
+  if( !i->second )
+    i->second = lazy_->decode(i->first);
+}
+
+
+Struct::const_iterator Struct::begin() const
+{
+  if( lazy_ )
+  {
+    for( Value_stor::iterator i = values.begin(); i != values.end(); ++i )
+      decode(i);
+  }
+
+  return const_iterator(values.begin());
+}
+
+
+Struct::const_iterator Struct::find( const std::string& key ) const
+{
+  Value_stor::iterator i = lookup(key);
+  decode(i);
+  return const_iterator(i);
+}
+
+
+Struct::iterator Struct::find( const std::string& key )
+{
+  hash_ = 0;
+  Value_stor::iterator i = lookup(key);
+  decode(i);
+  return iterator(i);
+}
+
+
+void Struct::erase( const std::string& key )
+{
+  hash_ = 0;
+  Value_stor::iterator i = lookup(key);
+  if( i == values.end() )
+    return;
+
+  delete i->second;
+  values.erase(i);
+}
+
+
 void Struct::clear()
 {
-  util::delete_ptrs(values.begin(), values.end(),
-    util::Select2nd<Value_stor>());
+  hash_ = 0;
+  for( Value_stor::iterator i = values.begin(); i != values.end(); ++i )
+    delete i->second;
 
   values.clear();
+  lazy_.reset();
 }
 
 void Struct::insert( const std::string& f, Value_ptr val )
 {
-  Value*& tmp = values[f];
-  delete tmp;
-  tmp = val.release();
+  hash_ = 0;
+  Value_stor::iterator i = lower_bound(f);
+
+  if( i != values.end() && i->first == f )
+  {
+    delete i->second;
+    i->second = val.release();
+    return;
+  }
+
+  // Pointer is released only after insertion succeeds.
+  Value_stor::iterator j = values.insert( i, std::make_pair(f, static_cast<Value*>(0)) );
+  j->second = val.release();
+}
+
+
+void Struct::append_unsorted( const std::string& f, Value_ptr val )
+{
+  values.push_back( std::make_pair(f, static_cast<Value*>(0)) );
+  values.back().second = val.release();
+}
+
+
+bool Struct::sort_members()
+{
+  // Stable sort keeps members with the same name in order of appending.
+  std::stable_sort( values.begin(), values.end(), Member_less() );
+
+  Value_stor::iterator out = values.begin();
+  for( Value_stor::iterator i = values.begin(); i != values.end(); ++i )
+  {
+    Value_stor::iterator next = i + 1;
+    if( next != values.end() && next->first == i->first )
+    {
+      delete i->second;
+      continue;
+    }
+
+    if( out != i )
+      out->swap( *i );
+
+    ++out;
+  }
+
+  bool unique = out == values.end();
+  values.erase( out, values.end() );
+  return unique;
 }
 
 
@@ -317,6 +707,14 @@ void Struct::insert( const std::string& f, const Value& val )
   insert(f, p);
 }
 
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+void Struct::insert( const std::string& f, Value&& val )
+{
+  Value_ptr p(new Value(std::move(val)));
+  insert(f, p);
+}
+#endif
+
 
 // ----------------------------------------------------------------------------
 const char Binary_data::base64_alpha[64] = {
@@ -329,98 +727,192 @@ const char Binary_data::base64_alpha[64] = {
 
 Binary_data* Binary_data::from_base64( const std::string& s )
 {
-  return new Binary_data( s, false );
+  return decode( s.data(), s.length() );
+}
+
+
+Binary_data* Binary_data::from_base64( const char* s, size_t size )
+{
+  return decode( s, size );
 }
 
 
 Binary_data* Binary_data::from_data( const std::string& s )
 {
-  return new Binary_data( s, true );
+  boost::shared_ptr<std::string> buf( new std::string(s) );
+  return new Binary_data( buf->data(), buf->length(), buf );
 }
 
 
 Binary_data* Binary_data::from_data( const char* s, size_t size )
 {
-  return new Binary_data( std::string(s, size), true );
+  boost::shared_ptr<std::string> buf( new std::string(s, size) );
+  return new Binary_data( buf->data(), buf->length(), buf );
 }
 
 
-Binary_data::Binary_data( const std::string& s, bool raw )
+Binary_data* Binary_data::from_buffer(
+  const char* d, size_t size, const boost::shared_ptr<const void>& owner )
 {
-  if( raw )
-    data = s;
-  else
+  // Nothing would tie the buffer's lifetime to copies of the object.
+  if( !owner )
+    return from_data( d, size );
+
+  return new Binary_data( d, size, owner );
+}
+
+
+namespace {
+
+#ifndef WIN32
+//! Read-only memory mapping of a whole file.
+class Mapped_file: boost::noncopyable {
+public:
+  Mapped_file( const std::string& path ):
+    addr_(0),
+    size_(0)
   {
-    base64 = s;
-    decode();
+    int fd = open( path.c_str(), O_RDONLY );
+    if( fd < 0 )
+      throw Binary_data::Cannot_map_file( path );
+
+    struct stat st;
+    if( fstat( fd, &st ) == 0 )
+    {
+      size_ = st.st_size;
+      // Empty file can not be mapped, but is valid.
+      addr_ = size_ ? mmap( 0, size_, PROT_READ, MAP_PRIVATE, fd, 0 ) : 0;
+    }
+
+    close( fd );
+
+    if( addr_ == MAP_FAILED || (size_ && !addr_) )
+      throw Binary_data::Cannot_map_file( path );
+
+    if( size_ )
+      madvise( addr_, size_, MADV_SEQUENTIAL );
   }
+
+  ~Mapped_file()
+  {
+    if( size_ )
+      munmap( addr_, size_ );
+  }
+
+  const char* data() const { return static_cast<const char*>(addr_); }
+  size_t size() const { return size_; }
+
+private:
+  void* addr_;
+  size_t size_;
+};
+#endif
+
+} // anonymous namespace
+
+
+Binary_data* Binary_data::from_file( const std::string& path )
+{
+#ifndef WIN32
+  boost::shared_ptr<Mapped_file> file( new Mapped_file(path) );
+  return new Binary_data( file->data(), file->size(), file );
+#else
+  std::ifstream f( path.c_str(), std::ios::in | std::ios::binary );
+  if( !f )
+    throw Cannot_map_file( path );
+
+  boost::shared_ptr<std::string> buf( new std::string(
+    (std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>() ) );
+  return new Binary_data( buf->data(), buf->length(), buf );
+#endif
 }
 
 
-const std::string& Binary_data::get_data() const
+Binary_data::Binary_data(
+  const char* d, size_t size, const boost::shared_ptr<const void>& owner
+):
+  Value_type(BASE64),
+  owner_(owner),
+  data_(d),
+  size_(size)
 {
-  return data;
 }
 
 
-const std::string& Binary_data::get_base64() const
+Binary_data* Binary_data::slice( size_t offset, size_t size ) const
 {
-  if( base64.empty() && !data.empty() )
-    encode();
+  if( offset > size_ || size > size_ - offset )
+    throw Out_of_range();
 
-  return base64;
+  return new Binary_data( data_ + offset, size, owner_ );
 }
 
 
-inline void Binary_data::add_base64_char( int idx ) const
+std::string Binary_data::get_data() const
 {
-  base64 += base64_alpha[idx];
+  return std::string( data_, size_ );
 }
 
 
-void Binary_data::encode() const
+std::string Binary_data::get_base64() const
 {
-  const char* d = data.data();
-  size_t dsz = data.length();
+  std::string retval;
+  append_base64( retval );
+  return retval;
+}
 
-  for( size_t i = 0; i < dsz; i += 3 )
-  {
-    unsigned c = 0xff0000 & d[i] << 16;
-    add_base64_char( (c >> 18) & 0x3f );
 
-    if( i+1 < dsz )
-    {
-      c |= 0x00ff00 & d[i+1] << 8;
-      add_base64_char( (c >> 12) & 0x3f );
-    }
-    else
-    {
-      add_base64_char( (c >> 12) & 0x3f );
-      base64 += "==";
-      return;
-    }
+void Binary_data::append_base64( std::string& out ) const
+{
+  encode( data_, size_, out );
+}
 
-    if( i+2 < dsz )
-    {
-      c |= 0x0000ff & d[i+2];
-      add_base64_char( (c >> 6) & 0x3f );
-      add_base64_char( c & 0x3f );
-    }
-    else
-    {
-      add_base64_char( (c >> 6) & 0x3f );
-      base64 += "=";
-      return;
-    }
-  }
+
+size_t Binary_data::base64_size( size_t data_size )
+{
+  return (data_size + 2) / 3 * 4;
 }
 
 
-inline char Binary_data::get_idx( char c )
+void Binary_data::encode( const char* data, size_t size, std::string& out )
 {
-  if( c == '=' )
-    throw End_of_data();
+  if( !size )
+    return;
+
+  size_t pos = out.length();
+  out.resize( pos + base64_size(size) );
+
+  const unsigned char* d = reinterpret_cast<const unsigned char*>(data);
+  char* o = &out[pos];
+  size_t i = 0;
 
+  for( ; i + 2 < size; i += 3 )
+  {
+    unsigned c = d[i] << 16 | d[i+1] << 8 | d[i+2];
+    *o++ = base64_alpha[c >> 18 & 0x3f];
+    *o++ = base64_alpha[c >> 12 & 0x3f];
+    *o++ = base64_alpha[c >> 6 & 0x3f];
+    *o++ = base64_alpha[c & 0x3f];
+  }
+
+  if( i == size )
+    return;
+
+  unsigned c = d[i] << 16;
+  if( i + 1 < size )
+    c |= d[i+1] << 8;
+
+  *o++ = base64_alpha[c >> 18 & 0x3f];
+  *o++ = base64_alpha[c >> 12 & 0x3f];
+  *o++ = i + 1 < size ? base64_alpha[c >> 6 & 0x3f] : '=';
+  *o = '=';
+}
+
+
+namespace {
+
+inline unsigned base64_index( char c )
+{
   if( c >= 'A' && c <= 'Z' )
     return c - 'A';
 
@@ -436,57 +928,63 @@ inline char Binary_data::get_idx( char c )
   if( c == '/' )
     return 63;
 
-  throw Malformed_base64();
+  throw Binary_data::Malformed_base64();
 }
 
-
-inline void Binary_data::decode_four( const std::string& four )
+//! Returns number of decoded bytes.
+inline size_t decode_four( const char* four, char* out )
 {
-  char c1 = four[0];
-  char c2 = four[1];
-  char c3 = four[2];
-  char c4 = four[3];
+  if( four[0] == '=' || four[1] == '=' )
+    throw Binary_data::Malformed_base64();
 
-  if( c1 == '=' || c2 == '=' )
-    throw Malformed_base64();
+  unsigned i1 = base64_index(four[0]);
+  unsigned i2 = base64_index(four[1]);
+  out[0] = char(i1 << 2 | i2 >> 4);
 
-  try {
-    unsigned pair = get_idx(c1) << 6 | get_idx(c2);
-    data += char(pair >> 4 & 0xff);
+  if( four[2] == '=' )
+    return 1;
 
-    pair = get_idx(c2) << 6 | get_idx(c3);
-    data += char(pair >> 2);
+  unsigned i3 = base64_index(four[2]);
+  out[1] = char(i2 << 4 | i3 >> 2);
 
-    pair = get_idx(c3) << 6 | get_idx(c4);
-    data += char(pair & 0xff);
-  }
-  catch( const End_of_data& )
-  {
-  }
+  if( four[3] == '=' )
+    return 2;
+
+  out[2] = char(i3 << 6 | base64_index(four[3]));
+  return 3;
 }
 
+} // anonymous namespace
+
 
-void Binary_data::decode()
+Binary_data* Binary_data::decode( const char* d, size_t dsz )
 {
-  const char* d = base64.data();
-  size_t dsz = base64.length();
-  std::string four;
+  // Data is decoded straight into the buffer which the object will share.
+  // It is sized for the worst case (no whitespace) and trimmed afterwards.
+  boost::shared_ptr<std::string> buf( new std::string(dsz / 4 * 3 + 1, '\0') );
+  char* out = &(*buf)[0];
+  size_t len = 0;
+  char four[4];
+  size_t n = 0;
 
   for( size_t i = 0; i < dsz; i++ )
   {
-    if( isspace( d[i] ) )
+    if( isspace( static_cast<unsigned char>(d[i]) ) )
       continue;
 
-    four += d[i];
-    if( four.length() == 4 )
+    four[n++] = d[i];
+    if( n == 4 )
     {
-      decode_four( four );
-      four.erase();
+      len += decode_four( four, out + len );
+      n = 0;
     }
   }
 
-  if( !four.empty() )
+  if( n )
     throw Malformed_base64();
+
+  buf->resize( len );
+  return new Binary_data( buf->data(), len, buf );
 }
 
 
@@ -509,43 +1007,149 @@ void Binary_data::apply_visitor(Value_type_visitor& v) const
 
 
 // ----------------------------------------------------------------------------
-Date_time::Date_time( const struct tm* t )
+namespace {
+
+// Length of "YYYYMMDDTHH:MM:SS".
+const size_t iso8601_length = 17;
+
+inline bool parse_digits( const char* s, int n, int& result )
+{
+  result = 0;
+  for( int i = 0; i < n; ++i )
+  {
+    unsigned d = static_cast<unsigned char>(s[i]) - '0';
+    if( d > 9 )
+      return false;
+
+    result = result * 10 + d;
+  }
+
+  return true;
+}
+
+inline void put_digits( char* s, int n, int value )
+{
+  for( int i = n - 1; i >= 0; --i, value /= 10 )
+    s[i] = '0' + value % 10;
+}
+
+//! Per thread cache of the last rendered second.
+/*! Timestamps of log-like data as well as "now" values tend to repeat
+ *  within a second, so they share rendered string. */
+struct Iso8601_cache {
+  int year, mon, mday, hour, min, sec;
+  char str[iso8601_length];
+
+  Iso8601_cache():
+    year(-1), mon(-1), mday(-1), hour(-1), min(-1), sec(-1) {}
+
+  bool matches( const struct tm& t ) const
+  {
+    return t.tm_sec == sec && t.tm_min == min && t.tm_hour == hour &&
+      t.tm_mday == mday && t.tm_mon == mon && t.tm_year == year;
+  }
+
+  void render( const struct tm& t )
+  {
+    put_digits( str, 4, t.tm_year + 1900 );
+    put_digits( str + 4, 2, t.tm_mon + 1 );
+    put_digits( str + 6, 2, t.tm_mday );
+    str[8] = 'T';
+    put_digits( str + 9, 2, t.tm_hour );
+    str[11] = ':';
+    put_digits( str + 12, 2, t.tm_min );
+    str[14] = ':';
+    put_digits( str + 15, 2, t.tm_sec );
+
+    year = t.tm_year; mon = t.tm_mon; mday = t.tm_mday;
+    hour = t.tm_hour; min = t.tm_min; sec = t.tm_sec;
+  }
+};
+
+boost::thread_specific_ptr<Iso8601_cache> iso8601_cache;
+
+inline bool in_range( int v, int lo, int hi )
+{
+  return v >= lo && v <= hi;
+}
+
+} // anonymous namespace
+
+
+Date_time::Date_time( const struct tm* t ):
+  Value_type(DATETIME)
 {
   tm_ = *t;
+  format();
 }
 
 
-Date_time::Date_time( bool use_lt )
+Date_time::Date_time( bool use_lt ):
+  Value_type(DATETIME)
 {
   using namespace boost::posix_time;
   ptime p = use_lt ? second_clock::local_time() : second_clock::universal_time();
   tm_ = to_tm(p);
+  format();
 }
 
 
-Date_time::Date_time( const std::string& s )
+Date_time::Date_time( const std::string& s ):
+  Value_type(DATETIME)
 {
-  if( s.length() != 17 || s[8] != 'T' )
+  const char* d = s.data();
+
+  if( s.length() != iso8601_length || d[8] != 'T' || d[11] != ':' || d[14] != ':' )
     throw Malformed_iso8601();
 
-  char alpha[] = "0123456789T:";
-  if( s.substr(0, 16).find_first_not_of(alpha) != std::string::npos )
+  memset( &tm_, 0, sizeof(tm_) );
+  int year = 0;
+  int mon = 0;
+
+  if( !parse_digits(d, 4, year) || !parse_digits(d + 4, 2, mon) ||
+      !parse_digits(d + 6, 2, tm_.tm_mday) ||
+      !parse_digits(d + 9, 2, tm_.tm_hour) ||
+      !parse_digits(d + 12, 2, tm_.tm_min) ||
+      !parse_digits(d + 15, 2, tm_.tm_sec) )
     throw Malformed_iso8601();
 
-  tm_.tm_year = atoi( s.substr(0, 4).c_str() ) - 1900;
-  tm_.tm_mon  = atoi( s.substr(4, 2).c_str() ) - 1;
-  tm_.tm_mday = atoi( s.substr(6, 2).c_str() );
-  tm_.tm_hour = atoi( s.substr(9, 2).c_str() );
-  tm_.tm_min  = atoi( s.substr(12, 2).c_str() );
-  tm_.tm_sec  = atoi( s.substr(15, 2).c_str() );
-
-  if( (tm_.tm_year < 0) || !(tm_.tm_mon >= 0 && tm_.tm_mon <= 11) ||
-      !(tm_.tm_mday >= 1 && tm_.tm_mday <= 31) ||
-      !(tm_.tm_hour >= 0 && tm_.tm_hour <= 23) ||
-      !(tm_.tm_min >= 0 && tm_.tm_min <= 59) ||
-      !(tm_.tm_sec >= 0 && tm_.tm_sec <= 61)
-    )
+  tm_.tm_year = year - 1900;
+  tm_.tm_mon  = mon - 1;
+  tm_.tm_isdst = -1;
+
+  if( (tm_.tm_year < 0) || !in_range(tm_.tm_mon, 0, 11) ||
+      !in_range(tm_.tm_mday, 1, 31) || !in_range(tm_.tm_hour, 0, 23) ||
+      !in_range(tm_.tm_min, 0, 59) || !in_range(tm_.tm_sec, 0, 61) )
     throw Malformed_iso8601();
+
+  // The string is already in canonical form.
+  cache = s;
+}
+
+
+void Date_time::format()
+{
+  bool regular = in_range(tm_.tm_year + 1900, 0, 9999) &&
+    in_range(tm_.tm_mon, 0, 98) && in_range(tm_.tm_mday, 0, 99) &&
+    in_range(tm_.tm_hour, 0, 99) && in_range(tm_.tm_min, 0, 99) &&
+    in_range(tm_.tm_sec, 0, 99);
+
+  if( !regular )
+  {
+    char s[64];
+    size_t n = strftime( s, sizeof(s), "%Y%m%dT%H:%M:%S", &tm_ );
+    cache.assign( s, n );
+    return;
+  }
+
+  Iso8601_cache* c = iso8601_cache.get();
+  if( !c )
+    iso8601_cache.reset( c = new Iso8601_cache );
+
+  if( !c->matches(tm_) )
+    c->render(tm_);
+
+  cache.assign( c->str, iso8601_length );
 }
 
 
@@ -566,16 +1170,34 @@ void Date_time::apply_visitor(Value_type_visitor& v) const
   v.visit_datetime(*this);
 }
 
+// --------------------------------------------------------------------------
+Raw_xml_value::Raw_xml_value(
+  const boost::shared_ptr<const std::string>& xml,
+  const std::string& tname
+):
+  xml_(xml),
+  type_name_(&tname)
+{
+}
 
-const std::string& Date_time::to_string() const
+Value_type* Raw_xml_value::clone() const
 {
-  if( cache.empty() )
-  {
-    char s[18];
-    strftime( s, 18, "%Y%m%dT%H:%M:%S", &tm_ );
-    cache = std::string( s, 17 );
-  }
+  return new Raw_xml_value(*this);
+}
 
+const std::string& Raw_xml_value::type_name() const
+{
+  return *type_name_;
+}
+
+void Raw_xml_value::apply_visitor(Value_type_visitor& v) const
+{
+  v.visit_raw_xml(*this);
+}
+
+
+const std::string& Date_time::to_string() const
+{
   return cache;
 }
 
@@ -7,6 +7,10 @@
 
 #include "except.h"
 #include "util.h"
+#include "value_arena.h"
+
+#include <boost/shared_ptr.hpp>
+#include <boost/smart_ptr/detail/atomic_count.hpp>
 
 #include <iterator>
 #include <map>
@@ -24,6 +28,10 @@ namespace iqxmlrpc {
 
 class Value;
 class Value_type_visitor;
+class Lazy_array_data;
+class Lazy_struct_data;
+class Lazy_parser;
+class Value_hasher;
 typedef util::ExplicitPtr<Value*> Value_ptr;
 
 template <class T> class Scalar;
@@ -35,13 +43,54 @@ typedef Scalar<std::string> String;
 
 
 //! Base type for XML-RPC types.
+/*! Objects are shared between copies of Value and copied on write. */
 class LIBIQXMLRPC_API Value_type {
 public:
+  //! Built-in types which can be told apart without virtual calls.
+  //! Other types, including user defined ones, are of OTHER kind.
+  enum Kind {
+    OTHER,
+    NIL,
+    INT,
+    INT64,
+    BOOL,
+    DOUBLE,
+    STRING,
+    ARRAY,
+    STRUCT,
+    BASE64,
+    DATETIME
+  };
+
+  explicit Value_type( Kind k = OTHER ): refs_(1), shareable_(true), kind_(k) {}
+  Value_type( const Value_type& v ): refs_(1), shareable_(true), kind_(v.kind_) {}
   virtual ~Value_type() {}
 
+  Kind kind() const { return static_cast<Kind>(kind_); }
+
+  Value_type& operator =( const Value_type& ) { return *this; }
+
   virtual Value_type*  clone()  const = 0;
   virtual const std::string& type_name() const = 0;
   virtual void apply_visitor(Value_type_visitor&) const = 0;
+
+  //! Placed into current Value_arena if any.
+  static void* operator new( size_t sz ) { return Value_arena::allocate_node(sz); }
+  static void operator delete( void* p ) { Value_arena::release_node(p); }
+  static void* operator new( size_t, void* p ) { return p; }
+  static void operator delete( void*, void* ) {}
+
+private:
+  friend class Value;
+  friend class Value_hasher;
+
+  //! Number of Value objects which refer to this one.
+  mutable boost::detail::atomic_count refs_;
+
+  //! Reset when mutable reference to the object was given out.
+  bool shareable_;
+
+  unsigned char kind_;
 };
 
 
@@ -51,12 +100,22 @@ class LIBIQXMLRPC_API Nil: public Value_type {
   int nope;
 
 public:
+  Nil(): Value_type(NIL) {}
+
   Value_type* clone() const;
   const std::string& type_name() const;
   void apply_visitor(Value_type_visitor&) const;
 };
 
 
+//! Kind of Scalar<T> object.
+template <class T> struct Scalar_kind { enum { value = Value_type::OTHER }; };
+template <> struct Scalar_kind<int> { enum { value = Value_type::INT }; };
+template <> struct Scalar_kind<int64_t> { enum { value = Value_type::INT64 }; };
+template <> struct Scalar_kind<bool> { enum { value = Value_type::BOOL }; };
+template <> struct Scalar_kind<double> { enum { value = Value_type::DOUBLE }; };
+template <> struct Scalar_kind<std::string> { enum { value = Value_type::STRING }; };
+
 //! Template for scalar types based on Value_type (e.g. Int, String, etc.)
 template <class T>
 class LIBIQXMLRPC_API Scalar: public Value_type {
@@ -64,7 +123,9 @@ protected:
   T value_;
 
 public:
-  Scalar( const T& t ): value_(t) {}
+  Scalar( const T& t ):
+    Value_type(static_cast<Kind>(Scalar_kind<T>::value)),
+    value_(t) {}
   Scalar<T>* clone() const { return new Scalar<T>(value_); }
 
   void apply_visitor(Value_type_visitor&) const;
@@ -79,6 +140,79 @@ public:
 #pragma warning(disable: 4251)
 #endif
 
+//! Numeric elements of Array kept in contiguous memory.
+/*! Elements are serialized straight from the buffer, without creating
+ *  Value objects. \see Array::packed()
+ */
+class LIBIQXMLRPC_API Packed_array_base {
+  friend class Array;
+
+  //! Set once Array has created values of all elements.
+  mutable boost::detail::atomic_count materialized_;
+
+public:
+  Packed_array_base(): materialized_(0) {}
+  virtual ~Packed_array_base() {}
+
+  virtual Packed_array_base* clone() const = 0;
+  virtual size_t size() const = 0;
+
+  //! Creates regular value of specified element.
+  virtual Value* element(size_t) const = 0;
+
+  //! Passes specified element to visitor as a scalar value.
+  virtual void visit_element(size_t, Value_type_visitor&) const = 0;
+};
+
+
+//! Packed elements of type int, int64_t, double or bool.
+template <class T>
+class LIBIQXMLRPC_API Packed_array: public Packed_array_base {
+  T* data_;
+  size_t size_;
+  size_t capacity_;
+
+public:
+  Packed_array();
+  Packed_array( const T* first, size_t n );
+  Packed_array( const Packed_array& );
+  ~Packed_array();
+
+  //! Copies elements of any container, e.g. std::vector<bool>.
+  template <class In>
+  Packed_array( In first, In last ):
+    data_(0), size_(0), capacity_(0)
+  {
+    reserve(std::distance(first, last));
+    for( ; first != last; ++first )
+      push_back(*first);
+  }
+
+  Packed_array& operator =( const Packed_array& );
+
+  void swap(Packed_array&) throw();
+  Packed_array* clone() const;
+
+  size_t size() const { return size_; }
+
+  //! Direct access to elements.
+  const T* data() const { return data_; }
+  T operator []( size_t i ) const { return data_[i]; }
+
+  void push_back( T );
+  void reserve( size_t );
+  void clear() { size_ = 0; }
+
+  Value* element(size_t) const;
+  void visit_element(size_t, Value_type_visitor&) const;
+};
+
+typedef Packed_array<int> Int_array;
+typedef Packed_array<int64_t> Int64_array;
+typedef Packed_array<double> Double_array;
+typedef Packed_array<bool> Bool_array;
+
+
 //! XML-RPC array type. Operates with objects of type Value, not Value_type.
 class LIBIQXMLRPC_API Array: public Value_type {
   typedef std::vector<Value*> Val_vector;
@@ -105,53 +239,102 @@ public:
   };
 
 private:
-  Val_vector values;
+  friend class Lazy_parser;
+  friend class Value_hasher;
+
+  //! Elements of lazy array are null until they are accessed.
+  mutable Val_vector values;
+  boost::shared_ptr<Lazy_array_data> lazy_;
+
+  //! Elements of packed array. values are created from them
+  //! on first access and kept as long as array is not modified.
+  Packed_array_base* packed_;
+
+  //! Hash computed by parser, zero if unknown. \see Value::hash()
+  size_t hash_;
+
+  Value& at( size_t ) const;
+
+  //! Creates values from packed elements, if not done yet.
+  void make_values() const;
+
+  //! Switches to regular storage and drops cached hash
+  //! before modification.
+  void unpack()
+  {
+    hash_ = 0;
+    if( packed_ )
+      drop_packed();
+  }
+
+  void drop_packed();
 
 public:
   Array( const Array& );
-  Array() {}
+  Array(): Value_type(ARRAY), packed_(0), hash_(0) {}
   ~Array();
 
+  //! Creates array which keeps elements packed. Grabs the ownership.
+  explicit Array( Packed_array_base* );
+
   Array& operator =( const Array& );
 
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+  Array( Array&& other ) noexcept: Value_type(ARRAY), packed_(0), hash_(0) { swap(other); }
+  Array& operator =( Array&& other ) noexcept { swap(other); return *this; }
+#endif
+
   void swap(Array&) throw();
   Array* clone() const;
   const std::string& type_name() const;
   void apply_visitor(Value_type_visitor&) const;
 
-  size_t size() const { return values.size(); }
+  size_t size() const { return packed_ ? packed_->size() : values.size(); }
 
   const Value& operator []( unsigned i ) const
   {
-    try {
-      return (*values.at(i));
-    }
-    catch( const std::out_of_range& )
-    {
-      throw Out_of_range();
-    }
+    return at(i);
   }
 
   Value& operator []( unsigned i )
   {
-    try {
-      return (*values.at(i));
-    }
-    catch( const std::out_of_range& )
-    {
-      throw Out_of_range();
-    }
+    unpack();
+    return at(i);
+  }
+
+  //! Packed elements, NULL if elements are kept as values.
+  /*! Array with packed elements behaves as regular one. Const access
+   *  to elements creates values once, non-const access unpacks it.
+   */
+  const Packed_array_base* packed() const { return packed_; }
+
+  //! Packed elements of type T (int, int64_t, double or bool),
+  //! NULL if elements are not packed or are of other type.
+  template <class T>
+  const Packed_array<T>* packed_as() const
+  {
+    return dynamic_cast<const Packed_array<T>*>(packed_);
   }
 
   void push_back( const Value& );
   void push_back( Value_ptr );
 
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+  //! Takes the content of value without copying it.
+  void push_back( Value&& );
+
+  //! Constructs new element in place from any argument accepted by Value.
+  template <class T>
+  void emplace_back( T&& );
+#endif
+
   void clear();
 
   //! Clears array and assigns from specified container's interval.
   template <class In>
   void assign( In first, In last );
 
+  //! Note that it creates values of packed elements.
   Array::const_iterator begin() const;
   Array::const_iterator end()   const;
 };
@@ -161,18 +344,24 @@ public:
 class LIBIQXMLRPC_API Array::const_iterator:
   public std::iterator<std::bidirectional_iterator_tag, Value>
 {
+  const Array* a;
   Array::Val_vector::const_iterator i;
 
+  const Value* get() const
+  {
+    return a->lazy_ ? &a->at(i - a->values.begin()) : *i;
+  }
+
 public:
-  const_iterator( Array::Val_vector::const_iterator i_ ):
-    i(i_) {}
+  const_iterator( const Array* a_, Array::Val_vector::const_iterator i_ ):
+    a(a_), i(i_) {}
   ~const_iterator() {}
 
-  const Value& operator *() const { return *(*i); }
-  const Value* operator ->() const { return *i; }
+  const Value& operator *() const { return *get(); }
+  const Value* operator ->() const { return get(); }
 
-  const_iterator operator ++( int ) { return const_iterator(i++); }
-  const_iterator operator --( int ) { return const_iterator(i--); }
+  const_iterator operator ++( int ) { return const_iterator(a, i++); }
+  const_iterator operator --( int ) { return const_iterator(a, i--); }
 
   const_iterator& operator ++() { ++i; return *this; }
   const_iterator& operator --() { --i; return *this; }
@@ -190,16 +379,55 @@ public:
 
 inline Array::const_iterator Array::begin() const
 {
-  return values.begin();
+  if( packed_ )
+    make_values();
+
+  return const_iterator(this, values.begin());
 }
 
 
 inline Array::const_iterator Array::end() const
 {
-  return values.end();
+  if( packed_ )
+    make_values();
+
+  return const_iterator(this, values.end());
 }
 
 
+//! Source of elements for Generated_array.
+class LIBIQXMLRPC_API Array_generator {
+public:
+  virtual ~Array_generator() {}
+
+  //! Returns next element or NULL when there are no more elements.
+  //! Returned value is owned by caller.
+  virtual Value* next() = 0;
+};
+
+
+//! Array which elements are produced on demand during serialization.
+/*! Elements are pulled from generator one by one and written into the
+ *  response right away, so the whole array never exists in memory.
+ *  Copies share the same generator, which can be traversed only once.
+ *  Note that it is not an Array: Value::is_array() returns false for it.
+ *  It is intended to be a method's result or a part of it.
+ */
+class LIBIQXMLRPC_API Generated_array: public Value_type {
+  boost::shared_ptr<Array_generator> gen_;
+
+public:
+  //! Grabs the ownership.
+  explicit Generated_array( Array_generator* );
+
+  Array_generator& generator() const { return *gen_; }
+
+  Value_type* clone() const;
+  const std::string& type_name() const;
+  void apply_visitor(Value_type_visitor&) const;
+};
+
+
 //! XML-RPC array type. Operates with objects of type Value, not Value_type.
 class LIBIQXMLRPC_API Struct: public Value_type {
 public:
@@ -212,22 +440,48 @@ public:
   };
 
 private:
-  typedef std::map<std::string, Value*> Value_stor;
-  class Struct_inserter;
-  friend class Struct_inserter;
+  //! Members are kept in a vector sorted by name. It is compact and
+  //! cache-friendly for small structs that XML-RPC usually carries.
+  typedef std::vector<std::pair<std::string, Value*> > Value_stor;
+  friend class Lazy_parser;
+  friend class Value_hasher;
+
+  //! Members of lazy struct are null until they are accessed.
+  mutable Value_stor values;
+  boost::shared_ptr<Lazy_struct_data> lazy_;
+
+  //! Hash computed by parser, zero if unknown. \see Value::hash()
+  size_t hash_;
 
-  Value_stor values;
+  void decode( Value_stor::iterator ) const;
+
+  //! Returns position of member or where it should be inserted.
+  Value_stor::iterator lower_bound( const std::string& ) const;
+
+  //! Returns position of member or end().
+  Value_stor::iterator lookup( const std::string& ) const;
+
+  template <class V> class Member_iterator;
 
 public:
-  typedef Value_stor::const_iterator const_iterator;
-  typedef Value_stor::iterator iterator;
+  //! Gives read-only access to members, since the struct may be shared
+  //! with its copies.
+  typedef Member_iterator<const Value> const_iterator;
+  //! Member names are kept sorted, so iterators never allow to change
+  //! them. Members themselves are changed via i->second.
+  typedef Member_iterator<Value> iterator;
 
   Struct( const Struct& );
-  Struct() {}
+  Struct(): Value_type(STRUCT), hash_(0) {}
   ~Struct();
 
   Struct& operator =( const Struct& );
 
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+  Struct( Struct&& other ) noexcept: Value_type(STRUCT), hash_(0) { swap(other); }
+  Struct& operator =( Struct&& other ) noexcept { swap(other); return *this; }
+#endif
+
   void swap(Struct&) throw();
   Struct* clone() const;
   const std::string& type_name() const;
@@ -243,20 +497,117 @@ public:
   void insert( const std::string&, Value_ptr );
   void insert( const std::string&, const Value& );
 
-  const_iterator begin() const { return values.begin(); }
-  const_iterator end()   const { return values.end(); }
+  //! Appends member without keeping members sorted.
+  /*! Inserting members one by one costs O(n^2) for a large unsorted
+   *  struct, so parser appends them and sorts once with sort_members().
+   *  Struct must not be used otherwise in between.
+   */
+  void append_unsorted( const std::string&, Value_ptr );
+
+  //! Sorts members added by append_unsorted().
+  //! Of members with the same name the last one is kept.
+  //! Returns false if there were such members.
+  bool sort_members();
+
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+  //! Takes the content of value without copying it.
+  void insert( const std::string&, Value&& );
+
+  //! Constructs new member in place from any argument accepted by Value.
+  template <class T>
+  void emplace( const std::string&, T&& );
+#endif
+
+  //! Note that it decodes all members of lazy struct.
+  const_iterator begin() const;
+  const_iterator end()   const;
 
-  const_iterator find( const std::string& key ) const { return values.find(key); }
-  iterator find( const std::string& key ) { return values.find(key); }
+  const_iterator find( const std::string& key ) const;
+  iterator find( const std::string& key );
 
-  void erase( const std::string& key ) { values.erase(key); }
+  void erase( const std::string& key );
 };
 
+
+//! Member of Struct as it is seen through Struct's iterators.
+template <class V>
+struct Struct_member {
+  Struct_member( const std::string& n, V* v ): first(n), second(v) {}
+
+  const std::string& first;
+  V* second;
+};
+
+
+//! Iterator over Struct's members.
+/*! Members are produced on the fly, so operator -> returns
+ *  a proxy which holds the member. */
+template <class V>
+class Struct::Member_iterator:
+  public std::iterator<std::bidirectional_iterator_tag, Struct_member<V> >
+{
+  friend class Struct;
+  template <class> friend class Member_iterator;
+
+  Struct::Value_stor::const_iterator i;
+
+  explicit Member_iterator( Struct::Value_stor::const_iterator i_ ): i(i_) {}
+
+public:
+  typedef Struct_member<V> member;
+
+  class Arrow {
+    member m;
+
+  public:
+    Arrow( const member& m_ ): m(m_) {}
+    const member* operator ->() const { return &m; }
+  };
+
+  Member_iterator() {}
+
+  operator Member_iterator<const Value>() const
+  {
+    return Member_iterator<const Value>(i);
+  }
+
+  member operator *() const { return member(i->first, i->second); }
+  Arrow operator ->() const { return Arrow(**this); }
+
+  Member_iterator operator ++( int ) { return Member_iterator(i++); }
+  Member_iterator operator --( int ) { return Member_iterator(i--); }
+
+  Member_iterator& operator ++() { ++i; return *this; }
+  Member_iterator& operator --() { --i; return *this; }
+
+  template <class U>
+  bool operator ==( const Member_iterator<U>& mi ) const
+  {
+    return i == mi.i;
+  }
+
+  template <class U>
+  bool operator !=( const Member_iterator<U>& mi ) const
+  {
+    return i != mi.i;
+  }
+};
+
+inline Struct::const_iterator Struct::end() const
+{
+  return const_iterator(values.end());
+}
+
 #ifdef _MSC_VER
 #pragma warning(disable: 4251)
 #endif
 
 //! XML-RPC Base64 type.
+/*! Raw data is kept in an immutable buffer which is shared between copies.
+ *  The buffer may be owned by the object itself, be a slice of another
+ *  Binary_data, or be provided by the user (e.g. a memory mapped file).
+ *  Base64 form is produced on demand and never cached.
+ */
 class LIBIQXMLRPC_API Binary_data: public Value_type {
 public:
   //! Malformed base64 encoding format exception.
@@ -266,40 +617,81 @@ public:
       Exception( "Malformed base64 format." ) {}
   };
 
+  //! Requested slice does not fit into data.
+  class Out_of_range: public Exception {
+  public:
+    Out_of_range():
+      Exception( "Binary_data: slice out of range." ) {}
+  };
+
+  //! File cannot be opened or mapped into memory.
+  class Cannot_map_file: public Exception {
+  public:
+    Cannot_map_file( const std::string& path ):
+      Exception( "Binary_data: cannot map file '" + path + "'." ) {}
+  };
+
 private:
   static const char base64_alpha[64];
 
-  std::string data;
-  mutable std::string base64;
+  boost::shared_ptr<const void> owner_;
+  const char* data_;
+  size_t size_;
 
 public:
   //! Construct an object from encoded data.
   static Binary_data* from_base64( const std::string& );
+  //! Construct an object from encoded data.
+  static Binary_data* from_base64( const char*, size_t size );
   //! Construct an object from raw data.
   static Binary_data* from_data( const std::string& );
   //! Construct an object from raw data.
   static Binary_data* from_data( const char*, size_t size );
 
+  //! Construct an object on top of external buffer without copying.
+  /*! Buffer must stay unchanged while any copy of the object exists.
+   *  \param owner keeps the buffer alive. If empty, data is copied
+   *  as from_data() does.
+   */
+  static Binary_data* from_buffer(
+    const char* data, size_t size, const boost::shared_ptr<const void>& owner );
+
+  //! Construct an object on top of read-only memory mapping of the file.
+  /*! Data is encoded straight from the mapping on serialization.
+   *  The file must not be truncated while any copy of the object exists.
+   */
+  static Binary_data* from_file( const std::string& path );
+
+  //! Size of base64 form of data of specified size.
+  static size_t base64_size( size_t data_size );
+
+  //! Append base64 form of raw data to the string.
+  static void encode( const char* data, size_t size, std::string& out );
+
+  //! Get part of data which shares the buffer with this object.
+  Binary_data* slice( size_t offset, size_t size ) const;
+
+  //! Raw data. Valid while any object sharing the buffer exists.
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
   //! Get data in encoded form.
-  const std::string& get_base64() const;
-  //! Get raw data.
-  const std::string& get_data() const;
+  std::string get_base64() const;
+  //! Get a copy of raw data.
+  std::string get_data() const;
+
+  //! Append data in encoded form to the string.
+  void append_base64( std::string& out ) const;
 
   Value_type* clone() const;
   const std::string& type_name() const;
   void apply_visitor( Value_type_visitor& ) const;
 
 private:
-  class End_of_data {};
-
-  Binary_data( const std::string&, bool raw );
-
-  void add_base64_char( int idx ) const;
-  void encode() const;
+  Binary_data(
+    const char* data, size_t size, const boost::shared_ptr<const void>& owner );
 
-  char get_idx( char );
-  void decode_four( const std::string& );
-  void decode();
+  static Binary_data* decode( const char*, size_t );
 };
 
 
@@ -315,7 +707,11 @@ public:
 
 private:
   struct tm tm_;
-  mutable std::string cache;
+  //! ISO8601 representation. It is prepared on construction,
+  //! so to_string() is safe to call from several threads.
+  std::string cache;
+
+  void format();
 
 public:
   Date_time( const struct tm* );
@@ -330,6 +726,33 @@ public:
   void apply_visitor(Value_type_visitor&) const;
 };
 
+
+//! Value which is already serialized into XML-RPC representation.
+/*! Serializer splices the fragment into output as is, so sending a large
+ *  rarely changing value costs a copy of memory instead of a tree walk.
+ *  Copies share the same fragment. Values are serialized in server mode,
+ *  so it is intended for responses.
+ */
+class LIBIQXMLRPC_API Raw_xml_value: public Value_type {
+  boost::shared_ptr<const std::string> xml_;
+  const std::string* type_name_;
+
+public:
+  //! Serialize the value once.
+  static Raw_xml_value* from_value( const Value& );
+
+  //! Content of <value> element.
+  const std::string& xml() const { return *xml_; }
+
+  Value_type* clone() const;
+  //! Type name of the serialized value.
+  const std::string& type_name() const;
+  void apply_visitor(Value_type_visitor&) const;
+
+private:
+  Raw_xml_value( const boost::shared_ptr<const std::string>&, const std::string& );
+};
+
 } // namespace iqxmlrpc
 
 #endif
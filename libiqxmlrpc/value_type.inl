@@ -4,6 +4,7 @@
 #ifndef _iqxmlrpc_value_type_inl_
 #define _iqxmlrpc_value_type_inl_
 
+#include <utility>
 #include "value.h"
 
 namespace iqxmlrpc {
@@ -16,6 +17,22 @@ void Array::assign( In first, In last )
     values.push_back( new Value(*first) );
 }
 
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+template <class T>
+void Array::emplace_back( T&& t )
+{
+  Value_ptr p(new Value(std::forward<T>(t)));
+  push_back(p);
+}
+
+template <class T>
+void Struct::emplace( const std::string& f, T&& t )
+{
+  Value_ptr p(new Value(std::forward<T>(t)));
+  insert(f, p);
+}
+#endif
+
 } // namespace iqxmlrpc
 
 #endif
@@ -4,11 +4,31 @@
 #include "value_type_visitor.h"
 
 #include "value.h"
+#include "value_parser.h"
 
 #include <iostream>
 
 namespace iqxmlrpc {
 
+void Value_type_visitor::do_visit_generated_array(const Generated_array& ga)
+{
+  Array a;
+  while (Value* v = ga.generator().next())
+    a.push_back(Value_ptr(v));
+
+  do_visit_array(a);
+}
+
+void Value_type_visitor::do_visit_raw_xml(const Raw_xml_value& r)
+{
+  Parser parser("<value>" + r.xml() + "</value>");
+  ValueElementBuilder builder(parser);
+  builder.build();
+
+  Value v(builder.result());
+  v.apply_visitor(*this);
+}
+
 Print_value_visitor::Print_value_visitor(std::ostream& out):
   out_(out)
 {
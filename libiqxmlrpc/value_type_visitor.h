@@ -63,6 +63,16 @@ public:
     do_visit_array(a);
   }
 
+  void visit_generated_array(const Generated_array& a)
+  {
+    do_visit_generated_array(a);
+  }
+
+  void visit_raw_xml(const Raw_xml_value& r)
+  {
+    do_visit_raw_xml(r);
+  }
+
   void visit_base64(const Binary_data& b)
   {
     do_visit_base64(b);
@@ -87,6 +97,12 @@ private:
   virtual void do_visit_array(const Array&) = 0;
   virtual void do_visit_base64(const Binary_data&) = 0;
   virtual void do_visit_datetime(const Date_time&) = 0;
+
+  //! By default elements are collected into Array which is visited then.
+  virtual void do_visit_generated_array(const Generated_array&);
+
+  //! By default the fragment is parsed and resulting value is visited.
+  virtual void do_visit_raw_xml(const Raw_xml_value&);
 };
 
 //! Value_type visitor that prints visited values recursively.
@@ -2,7 +2,10 @@
 //  Copyright (C) 2011 Anton Dedov
 
 #include <boost/lexical_cast.hpp>
+#include <memory>
+#include <string.h>
 
+#include "serialization_pool.h"
 #include "value.h"
 #include "value_type_xml.h"
 #include "xml_builder.h"
@@ -18,38 +21,50 @@ Value_type_to_xml::add_textnode(const char* name, const std::string& cont)
   n.set_textdata(cont);
 }
 
-void Value_type_to_xml::do_visit_value(const Value_type& v)
+void Value_type_to_xml::visit(const Value& v)
 {
   XmlNode value(builder_, "value");
-  v.apply_visitor(*this);
+  v.visit_static(*this);
 }
 
-void Value_type_to_xml::do_visit_nil()
+void Value_type_to_xml::visit_node(const Value_type& v)
+{
+  XmlNode value(builder_, "value");
+  Value::visit_static(v, *this);
+}
+
+void Value_type_to_xml::visit_other(const Value_type& v)
+{
+  Value_type_static_adapter<Value_type_to_xml> adapter(*this);
+  v.apply_visitor(adapter);
+}
+
+void Value_type_to_xml::visit_nil()
 {
   XmlNode(builder_, "nil");
 }
 
-void Value_type_to_xml::do_visit_int(int val)
+void Value_type_to_xml::visit_int(int val)
 {
   add_textnode("i4", boost::lexical_cast<std::string>(val));
 }
 
-void Value_type_to_xml::do_visit_int64(int64_t val)
+void Value_type_to_xml::visit_int64(int64_t val)
 {
   add_textnode("i8", boost::lexical_cast<std::string>(val));
 }
 
-void Value_type_to_xml::do_visit_double(double val)
+void Value_type_to_xml::visit_double(double val)
 {
   add_textnode("double", boost::lexical_cast<std::string>(val));
 }
 
-void Value_type_to_xml::do_visit_bool(bool val)
+void Value_type_to_xml::visit_bool(bool val)
 {
   add_textnode("boolean", val ? "1" : "0");
 }
 
-void Value_type_to_xml::do_visit_string(const std::string& val)
+void Value_type_to_xml::visit_string(const std::string& val)
 {
   if (server_mode_ && Value::omit_string_tag_in_responses()) {
     builder_.add_textdata(val);
@@ -58,7 +73,7 @@ void Value_type_to_xml::do_visit_string(const std::string& val)
   }
 }
 
-void Value_type_to_xml::do_visit_struct(const Struct& s)
+void Value_type_to_xml::visit_struct(const Struct& s)
 {
   XmlNode st(builder_, "struct");
 
@@ -67,33 +82,251 @@ void Value_type_to_xml::do_visit_struct(const Struct& s)
   {
     XmlNode member(builder_, "member");
     add_textnode("name", i->first);
-
-    Value_type_to_xml vis(builder_, server_mode_);
-    i->second->apply_visitor(vis);
+    visit(*i->second);
   }
 }
 
-void Value_type_to_xml::do_visit_array(const Array& a)
+void Value_type_to_xml::visit_array(const Array& a)
 {
   XmlNode arr(builder_, "array");
   XmlNode data(builder_, "data");
 
-  typedef Array::const_iterator CI;
-  Value_type_to_xml vis(builder_, server_mode_);
+  // Packed elements are written straight from the buffer.
+  if (const Packed_array_base* p = a.packed()) {
+    Value_type_static_adapter<Value_type_to_xml> adapter(*this);
+    for (size_t i = 0; i < p->size(); ++i) {
+      p->visit_element(i, adapter);
+    }
+    return;
+  }
+
+  if (parallel_) {
+    boost::shared_ptr<Serialization_pool> pool = Serialization_pool::instance();
+
+    if (pool && a.size() >= pool->min_array_size()) {
+      std::vector<std::string> parts;
+      pool->serialize(a, server_mode_, parts);
+
+      for (size_t i = 0; i < parts.size(); ++i)
+        builder_.add_raw_xml(parts[i]);
+
+      return;
+    }
+  }
 
+  typedef Array::const_iterator CI;
   for(CI i = a.begin(); i != a.end(); ++i ) {
-    i->apply_visitor(vis);
+    visit(*i);
+  }
+}
+
+void Value_type_to_xml::visit_generated_array(const Generated_array& ga)
+{
+  XmlNode arr(builder_, "array");
+  XmlNode data(builder_, "data");
+
+  Array_generator& gen = ga.generator();
+
+  for (std::auto_ptr<Value> v(gen.next()); v.get(); v.reset(gen.next())) {
+    visit(*v);
   }
 }
 
-void Value_type_to_xml::do_visit_base64(const Binary_data& bin)
+void Value_type_to_xml::visit_raw_xml(const Raw_xml_value& r)
 {
-  add_textnode("base64", bin.get_base64());
+  builder_.add_raw_xml(r.xml());
 }
 
-void Value_type_to_xml::do_visit_datetime(const Date_time& d)
+void Value_type_to_xml::visit_base64(const Binary_data& bin)
+{
+  XmlNode n(builder_, "base64");
+  builder_.add_base64(bin);
+}
+
+void Value_type_to_xml::visit_datetime(const Date_time& d)
 {
   add_textnode("dateTime.iso8601", d.to_string());
 }
 
+//
+// Value_type_xml_size
+//
+
+namespace {
+
+template <size_t N>
+inline size_t
+literal_size(const char (&)[N])
+{
+  return N - 1;
+}
+
+// Empty elements are collapsed by XmlBuilder.
+inline size_t
+empty_node_size(const char* name)
+{
+  return strlen(name) + 3;
+}
+
+template <class T>
+inline size_t
+decimal_size(T val)
+{
+  size_t n = val < 0 ? 2 : 1;
+  for (; val / 10; val /= 10)
+    ++n;
+
+  return n;
+}
+
+// The longest output of lexical_cast<std::string>(double),
+// e.g. "-1.2345678901234567e-308".
+const size_t max_double_size = 24;
+
+} // anonymous namespace
+
+size_t
+Value_type_xml_size::text_node_size(const char* name, const std::string& text)
+{
+  return 2 * strlen(name) + 5 + XmlBuilder::escaped_size(text);
+}
+
+void Value_type_xml_size::visit(const Value& v)
+{
+  size_ += literal_size("<value></value>");
+  v.visit_static(*this);
+}
+
+void Value_type_xml_size::visit_node(const Value_type& v)
+{
+  size_ += literal_size("<value></value>");
+  Value::visit_static(v, *this);
+}
+
+void Value_type_xml_size::visit_other(const Value_type& v)
+{
+  Value_type_static_adapter<Value_type_xml_size> adapter(*this);
+  v.apply_visitor(adapter);
+}
+
+void Value_type_xml_size::visit_nil()
+{
+  size_ += empty_node_size("nil");
+}
+
+void Value_type_xml_size::visit_int(int val)
+{
+  size_ += 2 * literal_size("i4") + 5 + decimal_size(val);
+}
+
+void Value_type_xml_size::visit_int64(int64_t val)
+{
+  size_ += 2 * literal_size("i8") + 5 + decimal_size(val);
+}
+
+void Value_type_xml_size::visit_double(double val)
+{
+  size_ += 2 * literal_size("double") + 5;
+  size_ += exact_ ? boost::lexical_cast<std::string>(val).size() : max_double_size;
+}
+
+void Value_type_xml_size::visit_bool(bool)
+{
+  size_ += 2 * literal_size("boolean") + 5 + 1;
+}
+
+void Value_type_xml_size::visit_string(const std::string& val)
+{
+  if (server_mode_ && Value::omit_string_tag_in_responses()) {
+    size_ += XmlBuilder::escaped_size(val);
+  } else {
+    size_ += text_node_size("string", val);
+  }
+}
+
+void Value_type_xml_size::visit_struct(const Struct& s)
+{
+  if (!s.size()) {
+    size_ += empty_node_size("struct");
+    return;
+  }
+
+  size_ += literal_size("<struct></struct>");
+
+  typedef Struct::const_iterator CI;
+  for(CI i = s.begin(); i != s.end(); ++i )
+  {
+    size_ += literal_size("<member></member>") + text_node_size("name", i->first);
+    visit(*i->second);
+  }
+}
+
+void Value_type_xml_size::visit_array(const Array& a)
+{
+  if (!a.size()) {
+    size_ += literal_size("<array></array>") + empty_node_size("data");
+    return;
+  }
+
+  size_ += literal_size("<array><data></data></array>");
+
+  if (const Packed_array_base* p = a.packed()) {
+    Value_type_static_adapter<Value_type_xml_size> adapter(*this);
+    for (size_t i = 0; i < p->size(); ++i) {
+      p->visit_element(i, adapter);
+    }
+    return;
+  }
+
+  typedef Array::const_iterator CI;
+  for(CI i = a.begin(); i != a.end(); ++i ) {
+    visit(*i);
+  }
+}
+
+void Value_type_xml_size::visit_generated_array(const Generated_array&)
+{
+  known_ = false;
+}
+
+void Value_type_xml_size::visit_raw_xml(const Raw_xml_value& r)
+{
+  size_ += r.xml().size();
+}
+
+void Value_type_xml_size::visit_base64(const Binary_data& bin)
+{
+  size_ += 2 * literal_size("base64") + 5 + Binary_data::base64_size(bin.size());
+}
+
+void Value_type_xml_size::visit_datetime(const Date_time& d)
+{
+  size_ += text_node_size("dateTime.iso8601", d.to_string());
+}
+
+//
+// Raw_xml_value
+//
+
+Raw_xml_value* Raw_xml_value::from_value(const Value& v)
+{
+  XmlBuilder builder;
+  Value_type_to_xml vis(builder, true);
+  vis.visit(v);
+
+  std::string buf;
+  builder.swap_content(buf);
+
+  // Builder produces XML declaration followed by "<value>...</value>".
+  // Only the content of value element is retained.
+  const size_t open_len = sizeof("<value>") - 1;
+  const size_t close_len = sizeof("</value>") - 1;
+  size_t begin = buf.find("<value>") + open_len;
+
+  boost::shared_ptr<std::string> xml(
+    new std::string(buf, begin, buf.size() - begin - close_len));
+
+  return new Raw_xml_value(xml, v.type_name());
+}
+
 } // namespace iqxmlrpc
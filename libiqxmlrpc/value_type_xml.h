@@ -7,31 +7,121 @@
 namespace iqxmlrpc {
 
 class XmlBuilder;
+class Value;
 
-//! Value_type visitor that converts values into XML-RPC representation.
-class Value_type_to_xml: public Value_type_visitor {
+//! Passes calls of Value_type_visitor interface to static visitor V.
+/*! It lets types of Value_type::OTHER kind serialize themselves
+ *  through their apply_visitor(). \see Value::visit_static */
+template <class V>
+class Value_type_static_adapter: public Value_type_visitor {
 public:
-  Value_type_to_xml(XmlBuilder& builder, bool server_mode = false):
-    builder_(builder),
-    server_mode_(server_mode) {}
+  Value_type_static_adapter(V& v): v_(v) {}
 
 private:
-  virtual void do_visit_value(const Value_type&);
-  virtual void do_visit_nil();
-  virtual void do_visit_int(int);
-  virtual void do_visit_int64(int64_t);
-  virtual void do_visit_double(double);
-  virtual void do_visit_bool(bool);
-  virtual void do_visit_string(const std::string&);
-  virtual void do_visit_struct(const Struct&);
-  virtual void do_visit_array(const Array&);
-  virtual void do_visit_base64(const Binary_data&);
-  virtual void do_visit_datetime(const Date_time&);
+  void do_visit_value(const Value_type& v)          { v_.visit_node(v); }
+  void do_visit_nil()                               { v_.visit_nil(); }
+  void do_visit_int(int i)                          { v_.visit_int(i); }
+  void do_visit_int64(int64_t i)                    { v_.visit_int64(i); }
+  void do_visit_double(double d)                    { v_.visit_double(d); }
+  void do_visit_bool(bool b)                        { v_.visit_bool(b); }
+  void do_visit_string(const std::string& s)        { v_.visit_string(s); }
+  void do_visit_struct(const Struct& s)             { v_.visit_struct(s); }
+  void do_visit_array(const Array& a)               { v_.visit_array(a); }
+  void do_visit_generated_array(const Generated_array& a) { v_.visit_generated_array(a); }
+  void do_visit_raw_xml(const Raw_xml_value& r)     { v_.visit_raw_xml(r); }
+  void do_visit_base64(const Binary_data& b)        { v_.visit_base64(b); }
+  void do_visit_datetime(const Date_time& d)        { v_.visit_datetime(d); }
+
+  V& v_;
+};
+
+//! Converts values into XML-RPC representation.
+/*! Built-in types are dispatched by Value::visit_static(),
+ *  so there are no virtual calls per node of value tree.
+ */
+class Value_type_to_xml {
+public:
+  //! Large arrays are split between threads of Serialization_pool,
+  //! if it is configured and parallel flag is set.
+  Value_type_to_xml(XmlBuilder& builder, bool server_mode = false, bool parallel = true):
+    builder_(builder),
+    server_mode_(server_mode),
+    parallel_(parallel) {}
+
+  //! Write <value> element.
+  void visit(const Value&);
+  void visit_node(const Value_type&);
+
+  //! \name Static visitor interface
+  //! \{
+  void visit_nil();
+  void visit_int(int);
+  void visit_int64(int64_t);
+  void visit_double(double);
+  void visit_bool(bool);
+  void visit_string(const std::string&);
+  void visit_struct(const Struct&);
+  void visit_array(const Array&);
+  void visit_generated_array(const Generated_array&);
+  void visit_raw_xml(const Raw_xml_value&);
+  void visit_base64(const Binary_data&);
+  void visit_datetime(const Date_time&);
+  void visit_other(const Value_type&);
+  //! \}
 
+private:
   void add_textnode(const char* name, const std::string& data);
 
   XmlBuilder& builder_;
   bool server_mode_;
+  bool parallel_;
+};
+
+//! Computes size of XML produced by Value_type_to_xml.
+/*! In non-exact mode textual length of doubles is not calculated,
+ *  upper bound is taken instead. Size of generated arrays is unknown.
+ */
+class Value_type_xml_size {
+public:
+  Value_type_xml_size(bool server_mode, bool exact):
+    size_(0),
+    known_(true),
+    server_mode_(server_mode),
+    exact_(exact) {}
+
+  size_t size()  const { return size_; }
+  bool   known() const { return known_; }
+
+  //! Size of element with escaped text.
+  static size_t
+  text_node_size(const char* name, const std::string& text);
+
+  //! Add size of <value> element.
+  void visit(const Value&);
+  void visit_node(const Value_type&);
+
+  //! \name Static visitor interface
+  //! \{
+  void visit_nil();
+  void visit_int(int);
+  void visit_int64(int64_t);
+  void visit_double(double);
+  void visit_bool(bool);
+  void visit_string(const std::string&);
+  void visit_struct(const Struct&);
+  void visit_array(const Array&);
+  void visit_generated_array(const Generated_array&);
+  void visit_raw_xml(const Raw_xml_value&);
+  void visit_base64(const Binary_data&);
+  void visit_datetime(const Date_time&);
+  void visit_other(const Value_type&);
+  //! \}
+
+private:
+  size_t size_;
+  bool known_;
+  bool server_mode_;
+  bool exact_;
 };
 
 } // namespace iqxmlrpc
@@ -1,26 +1,121 @@
 //  Libiqxmlrpc - an object-oriented XML-RPC solution.
 //  Copyright (C) 2011 Anton Dedov
 
-#include <stdexcept>
-#include "except.h"
+#include <string.h>
 #include "xml_builder.h"
+#include "value_type.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace iqxmlrpc {
 
 namespace {
 
-template <class T>
+const char xml_declaration[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+
+// Characters which have to be escaped in text content. Zero terminates
+// the text, as libxml2 accepts C strings.
+inline bool
+is_special(char c)
+{
+  return c == '<' || c == '>' || c == '&' || c == '"' || c == '\r' || c == '\0';
+}
+
+//! Returns position of the first special character in [p, end).
+inline const char*
+find_special(const char* p, const char* end)
+{
+#ifdef __SSE2__
+  const __m128i lt = _mm_set1_epi8('<');
+  const __m128i gt = _mm_set1_epi8('>');
+  const __m128i amp = _mm_set1_epi8('&');
+  const __m128i quot = _mm_set1_epi8('"');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i zero = _mm_setzero_si128();
+
+  for (; end - p >= 16; p += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i m = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt)),
+      _mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, quot)));
+    m = _mm_or_si128(m, _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, zero)));
+
+    int mask = _mm_movemask_epi8(m);
+    if (mask)
+      return p + __builtin_ctz(mask);
+  }
+#endif
+
+  for (; p != end && !is_special(*p); ++p) {}
+  return p;
+}
+
+//! Appends text escaped the same way as xmlEncodeSpecialChars() does.
 void
-throwBuildError(T res, T err_res)
+append_escaped(std::string& buf, const std::string& text)
 {
-  if (res == err_res) {
-    xmlErrorPtr err = xmlGetLastError();
-    throw XmlBuild_error(err ? err->message : "unknown error");
+  const char* p = text.data();
+  const char* end = p + text.size();
+
+  for (;;) {
+    const char* s = find_special(p, end);
+    buf.append(p, s - p);
+
+    if (s == end)
+      return;
+
+    switch (*s) {
+    case '<':  buf.append("&lt;", 4); break;
+    case '>':  buf.append("&gt;", 4); break;
+    case '&':  buf.append("&amp;", 5); break;
+    case '"':  buf.append("&quot;", 6); break;
+    case '\r': buf.append("&#13;", 5); break;
+    default:
+      return; // '\0'
+    }
+
+    p = s + 1;
   }
 }
 
 } // anonymous namespace
 
+size_t
+XmlBuilder::declaration_size()
+{
+  return sizeof(xml_declaration) - 1;
+}
+
+size_t
+XmlBuilder::escaped_size(const std::string& text)
+{
+  const char* p = text.data();
+  const char* end = p + text.size();
+  size_t sz = 0;
+
+  for (;;) {
+    const char* s = find_special(p, end);
+    sz += s - p;
+
+    if (s == end)
+      return sz;
+
+    switch (*s) {
+    case '<':
+    case '>':  sz += 4; break;
+    case '&':
+    case '\r': sz += 5; break;
+    case '"':  sz += 6; break;
+    default:
+      return sz; // '\0'
+    }
+
+    p = s + 1;
+  }
+}
+
 //
 // XmlBuilder::Node
 //
@@ -28,13 +123,12 @@ throwBuildError(T res, T err_res)
 XmlBuilder::Node::Node(XmlBuilder& w, const char* name):
   ctx(w)
 {
-  const xmlChar* xname = reinterpret_cast<const xmlChar*>(name);
-  throwBuildError(xmlTextWriterStartElement(ctx.writer, xname), -1);
+  ctx.start_element(name);
 }
 
 XmlBuilder::Node::~Node()
 {
-  xmlTextWriterEndElement(ctx.writer);
+  ctx.end_element();
 }
 
 void
@@ -47,38 +141,88 @@ XmlBuilder::Node::set_textdata(const std::string& data)
 // XmlBuilder
 //
 
-XmlBuilder::XmlBuilder()
+XmlBuilder::XmlBuilder(bool declaration):
+  start_tag_open(false)
 {
-  buf = xmlBufferCreate();
-  throwBuildError(writer = xmlNewTextWriterMemory(buf, 0), (xmlTextWriter*)0);
-  throwBuildError(xmlTextWriterStartDocument(writer, NULL, "UTF-8", NULL), -1);
+  buf.reserve(1024);
+
+  if (declaration)
+    buf.append(xml_declaration, sizeof(xml_declaration) - 1);
 }
 
 XmlBuilder::~XmlBuilder()
 {
-  xmlFreeTextWriter(writer);
-  xmlBufferFree(buf);
+}
+
+void
+XmlBuilder::start_element(const char* name)
+{
+  close_start_tag();
+  buf += '<';
+  buf.append(name);
+  elements.push_back(name);
+  start_tag_open = true;
+}
+
+void
+XmlBuilder::end_element()
+{
+  // Document may be already finished by stop().
+  if (elements.empty())
+    return;
+
+  if (start_tag_open) {
+    buf.append("/>", 2);
+    start_tag_open = false;
+  } else {
+    buf.append("</", 2);
+    buf.append(elements.back());
+    buf += '>';
+  }
+
+  elements.pop_back();
 }
 
 void
 XmlBuilder::add_textdata(const std::string& data)
 {
-  const xmlChar* xdata = reinterpret_cast<const xmlChar*>(data.c_str());
-  throwBuildError(xmlTextWriterWriteString(writer, xdata), -1);
+  close_start_tag();
+  append_escaped(buf, data);
+}
+
+void
+XmlBuilder::add_base64(const Binary_data& bin)
+{
+  close_start_tag();
+  bin.append_base64(buf);
+}
+
+void
+XmlBuilder::add_raw_xml(const std::string& xml)
+{
+  close_start_tag();
+  buf.append(xml);
 }
 
 void
 XmlBuilder::stop()
 {
-  throwBuildError(xmlTextWriterEndDocument(writer), -1);
+  while (!elements.empty())
+    end_element();
+
+  buf += '\n';
 }
 
 std::string
 XmlBuilder::content() const
 {
-  xmlTextWriterFlush(writer);
-  const char* cdata = reinterpret_cast<const char*>(xmlBufferContent(buf));
-  return std::string(cdata, buf->use);
+  return buf;
+}
+
+void
+XmlBuilder::swap_content(std::string& s)
+{
+  buf.swap(s);
 }
 
 } // namespace iqxmlrpc
@@ -8,14 +8,23 @@
 
 #include <boost/utility.hpp>
 #include <string>
-#include <libxml/xmlwriter.h>
+#include <vector>
 
 namespace iqxmlrpc {
 
+class Binary_data;
+
+//! Writes XML document directly into a string buffer.
+/*! Output is the same as of libxml2's xmlTextWriter with
+ *  default settings: no indentation, empty elements are
+ *  collapsed to <tag/>, and text is escaped as by
+ *  xmlEncodeSpecialChars().
+ */
 class XmlBuilder: boost::noncopyable {
 public:
   class Node {
   public:
+    //! Name must stay valid during the node's lifetime.
     Node(XmlBuilder&, const char* name);
     ~Node();
 
@@ -26,21 +35,71 @@ public:
     XmlBuilder& ctx;
   };
 
-  XmlBuilder();
+  //! Document fragments are built without XML declaration.
+  explicit XmlBuilder(bool declaration = true);
   ~XmlBuilder();
 
+  //! Size of XML declaration which starts each document.
+  static size_t
+  declaration_size();
+
+  //! Size of text after escaping.
+  static size_t
+  escaped_size(const std::string&);
+
+  //! Preallocate buffer for the whole document.
+  void
+  reserve(size_t sz)
+  {
+    buf.reserve(sz);
+  }
+
   void
   add_textdata(const std::string&);
 
+  //! Append base64 form of data encoding it directly into the buffer.
+  void
+  add_base64(const Binary_data&);
+
+  //! Append already serialized XML without any escaping.
+  void
+  add_raw_xml(const std::string&);
+
+  //! Close all open elements and finish the document.
   void
   stop();
 
   std::string
   content() const;
 
+  //! Move built document out of builder without copying.
+  void
+  swap_content(std::string&);
+
+  //! Size of output produced so far.
+  size_t
+  size() const { return buf.size(); }
+
+  //! Open element. Prefer Node, unless element spans several calls.
+  void
+  start_element(const char* name);
+
+  void
+  end_element();
+
 private:
-  xmlBufferPtr buf;
-  xmlTextWriterPtr writer;
+  void
+  close_start_tag()
+  {
+    if (start_tag_open) {
+      buf += '>';
+      start_tag_open = false;
+    }
+  }
+
+  std::string buf;
+  std::vector<const char*> elements;
+  bool start_tag_open;
 };
 
 } // namespace iqxmlrpc
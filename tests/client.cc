@@ -3,11 +3,17 @@
 #include <openssl/md5.h>
 #include <iostream>
 #include <memory>
+#include <boost/lexical_cast.hpp>
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread/thread.hpp>
 #include "libiqxmlrpc/libiqxmlrpc.h"
+#include "libiqxmlrpc/coalescing_interceptor.h"
+#include "libiqxmlrpc/dispatcher_manager.h"
 #include "libiqxmlrpc/http_client.h"
 #include "libiqxmlrpc/http_errors.h"
+#include "libiqxmlrpc/memoizing_interceptor.h"
+#include "libiqxmlrpc/typed_method.h"
 #include "client_common.h"
 #include "client_opts.h"
 
@@ -124,6 +130,398 @@ BOOST_AUTO_TEST_CASE( get_file_test )
   BOOST_CHECK(gen_md5->get_base64() == m.get_base64());
 }
 
+BOOST_AUTO_TEST_CASE( streaming_method_test )
+{
+  BOOST_REQUIRE(test_client);
+
+  Array a;
+  for (int i = 1; i <= 100; ++i)
+    a.push_back(i);
+
+  Struct s;
+  s.insert("arr", a);
+  s.insert("dbl", 0.5);
+
+  Param_list pl;
+  pl.push_back(s);
+  pl.push_back(10);
+
+  Response retval( test_client->execute("sum_streamed", pl) );
+  BOOST_REQUIRE_MESSAGE(!retval.is_fault(), retval.fault_string());
+  BOOST_CHECK_EQUAL(retval.value().get_double(), 5060.5);
+}
+
+BOOST_AUTO_TEST_CASE( generated_array_test )
+{
+  BOOST_REQUIRE(test_client);
+
+  Response retval( test_client->execute("generate_rows", Param_list(1, 100000)) );
+  BOOST_REQUIRE_MESSAGE(!retval.is_fault(), retval.fault_string());
+
+  const Value& v = retval.value();
+  BOOST_REQUIRE_EQUAL(v.size(), 100000);
+  BOOST_CHECK_EQUAL(v[0]["id"].get_int(), 0);
+  BOOST_CHECK_EQUAL(v[99999]["id"].get_int(), 99999);
+  BOOST_CHECK_EQUAL(v[99999]["name"].get_string(), "row");
+}
+
+namespace {
+
+struct Rows_call {
+  Rows_call(int n, size_t& r): rows(n), result(r) {}
+
+  void operator ()()
+  {
+    std::auto_ptr<Client_base> client(test_config.create_instance());
+    Response retval(client->execute("generate_rows", Param_list(1, rows)));
+    result = retval.is_fault() ? 0 : retval.value().size();
+  }
+
+  int rows;
+  size_t& result;
+};
+
+} // anonymous namespace
+
+// Pool server produces parts of streamed responses in executor's threads.
+BOOST_AUTO_TEST_CASE( concurrent_streams_test )
+{
+  std::vector<size_t> results(4, 0);
+  boost::thread_group threads;
+  for (size_t i = 0; i < results.size(); ++i)
+    threads.create_thread(Rows_call(20000, results[i]));
+  threads.join_all();
+
+  for (size_t i = 0; i < results.size(); ++i)
+    BOOST_CHECK_EQUAL(results[i], 20000u);
+}
+
+BOOST_AUTO_TEST_CASE( typed_method_test )
+{
+  BOOST_REQUIRE(test_client);
+
+  Array values;
+  values.push_back(1.5);
+  values.push_back(2.5);
+
+  Param_list pl;
+  pl.push_back(2.0);
+  pl.push_back(values);
+
+  Response retval( test_client->execute("scale_sum", pl) );
+  BOOST_REQUIRE_MESSAGE(!retval.is_fault(), retval.fault_string());
+  BOOST_CHECK_EQUAL(retval.value().get_double(), 8.0);
+
+  pl[1] = "not an array";
+  retval = test_client->execute("scale_sum", pl);
+  BOOST_CHECK(retval.is_fault());
+  BOOST_CHECK_EQUAL(retval.fault_code(), Invalid_meth_params().code());
+
+  retval = test_client->execute("scale_sum", Param_list(1, 2.0));
+  BOOST_CHECK(retval.is_fault());
+
+  // Typed encoding of parameters and decoding of result.
+  std::vector<double> native(3, 0.5);
+  pl[1] = to_value(native);
+  retval = test_client->execute("scale_sum", pl);
+  BOOST_CHECK_EQUAL(retval.value_as<double>(), 3.0);
+
+  retval = test_client->execute("system.methodSignature", Param_list(1, "scale_sum"));
+  BOOST_REQUIRE_MESSAGE(!retval.is_fault(), retval.fault_string());
+  const Value& sigs = retval.value();
+  BOOST_REQUIRE_EQUAL(sigs.size(), 1);
+  BOOST_REQUIRE_EQUAL(sigs[0].size(), 3);
+  BOOST_CHECK_EQUAL(sigs[0][0].get_string(), "double");
+  BOOST_CHECK_EQUAL(sigs[0][1].get_string(), "double");
+  BOOST_CHECK_EQUAL(sigs[0][2].get_string(), "array");
+
+  retval = test_client->execute("system.methodSignature", Param_list(1, "echo"));
+  BOOST_REQUIRE_MESSAGE(!retval.is_fault(), retval.fault_string());
+  BOOST_CHECK_EQUAL(retval.value().get_string(), "undef");
+}
+
+BOOST_AUTO_TEST_CASE( lazy_response_test )
+{
+  BOOST_REQUIRE(test_client);
+
+  Array a;
+  for (int i = 0; i < 1000; ++i)
+    a.push_back(i);
+
+  Struct s;
+  s.insert("arr", a);
+  s.insert("str", "lazy");
+
+  Echo_proxy echo(test_client);
+  Error_proxy err(test_client);
+  test_client->set_lazy_responses(true);
+  Response retval(echo(s));
+  Response fault(err(""));
+  test_client->set_lazy_responses(false);
+
+  const Value& v = retval.value();
+  BOOST_CHECK_EQUAL(v["str"].get_string(), "lazy");
+  BOOST_CHECK_EQUAL(v["arr"].size(), 1000);
+  BOOST_CHECK_EQUAL(v["arr"][999].get_int(), 999);
+  BOOST_CHECK(fault.is_fault());
+  BOOST_CHECK_EQUAL(fault.fault_code(), 123);
+}
+
+BOOST_AUTO_TEST_CASE( chunked_response_test )
+{
+  BOOST_REQUIRE(test_client);
+
+  Array a;
+  for (int i = 0; i < 3000; ++i)
+  {
+    Struct s;
+    s.insert("id", i);
+    s.insert("name", "element " + boost::lexical_cast<std::string>(i));
+    a.push_back(s);
+  }
+
+  // Test server started with --response-chunk-sz streams it by chunks.
+  Echo_proxy echo(test_client);
+  Response retval(echo(a));
+
+  const Value& v = retval.value();
+  BOOST_REQUIRE_EQUAL(v.size(), 3000);
+  BOOST_CHECK_EQUAL(v[0]["name"].get_string(), "element 0");
+  BOOST_CHECK_EQUAL(v[2999]["id"].get_int(), 2999);
+  BOOST_CHECK_EQUAL(v[2999]["name"].get_string(), "element 2999");
+}
+
+BOOST_AUTO_TEST_CASE( memoized_method_test )
+{
+  if (!test_config.memoize())
+    return;
+
+  BOOST_REQUIRE(test_client);
+
+  Response first(test_client->execute("count_calls", Param_list(1, "a")));
+  BOOST_REQUIRE_MESSAGE(!first.is_fault(), first.fault_string());
+
+  // Repeated call is answered from the server's cache.
+  Response second(test_client->execute("count_calls", Param_list(1, "a")));
+  BOOST_CHECK_EQUAL(second.value().get_int(), first.value().get_int());
+
+  Response other(test_client->execute("count_calls", Param_list(1, "b")));
+  BOOST_CHECK(other.value().get_int() > first.value().get_int());
+
+  test_client->execute("memo.invalidate", Param_list(1, "count_calls"));
+  Response fresh(test_client->execute("count_calls", Param_list(1, "a")));
+  BOOST_CHECK(fresh.value().get_int() > other.value().get_int());
+}
+
+namespace {
+
+boost::mutex slow_calls_lock;
+int slow_calls = 0;
+
+void slow_count(Method*, const Param_list&, Value& retval)
+{
+  boost::this_thread::sleep(boost::posix_time::milliseconds(300));
+  boost::mutex::scoped_lock lk(slow_calls_lock);
+  retval = ++slow_calls;
+}
+
+class Slow_generator: public Array_generator {
+public:
+  Slow_generator(): i_(0) {}
+
+  Value* next()
+  {
+    return i_ < 3 ? new Value(i_++) : 0;
+  }
+
+private:
+  int i_;
+};
+
+void slow_generate(Method*, const Param_list&, Value& retval)
+{
+  boost::this_thread::sleep(boost::posix_time::milliseconds(300));
+  retval = Generated_array(new Slow_generator);
+}
+
+struct Coalesced_call {
+  Coalesced_call(Method_dispatcher_manager& d, Coalescing_interceptor& i, Value& r,
+                 const std::string& n = "slow_count"):
+    disp(d), ic(i), result(r), method(n) {}
+
+  void operator ()()
+  {
+    Method::Data data = { method, iqnet::Inet_addr(), Server_feedback() };
+    std::auto_ptr<Method> m(disp.create_method(data));
+    m->process_execution(&ic, Param_list(1, "x"), result);
+  }
+
+  Method_dispatcher_manager& disp;
+  Coalescing_interceptor& ic;
+  Value& result;
+  std::string method;
+};
+
+} // anonymous namespace
+
+// Runs interceptor in-process, as executor's threads do.
+BOOST_AUTO_TEST_CASE( coalescing_interceptor_test )
+{
+  Method_dispatcher_manager disp;
+  disp.register_method("slow_count", new Method_factory<Method_function_adapter>(slow_count));
+
+  Coalescing_interceptor ic;
+  ic.coalesce_method("slow_count");
+
+  std::vector<Value> results(3, Value(0));
+  boost::thread_group threads;
+  for (size_t i = 0; i < results.size(); ++i)
+    threads.create_thread(Coalesced_call(disp, ic, results[i]));
+  threads.join_all();
+
+  BOOST_CHECK_EQUAL(slow_calls, 1);
+  BOOST_CHECK_EQUAL(ic.coalesced(), 2u);
+
+  // Leader keeps own result, waiters share its serialized copy.
+  std::vector<Value> shared;
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    if (results[i].is_int())
+      BOOST_CHECK_EQUAL(results[i].get_int(), 1);
+    else
+      shared.push_back(results[i]);
+  }
+
+  BOOST_REQUIRE_EQUAL(shared.size(), 2u);
+  BOOST_CHECK(shared[0] == shared[1]);
+
+  // Finished calls are not shared.
+  Value next(0);
+  Coalesced_call(disp, ic, next)();
+  BOOST_CHECK_EQUAL(slow_calls, 2);
+  BOOST_CHECK(next != results[0]);
+
+  // Generated array can be serialized once, so leader gets the same copy.
+  disp.register_method("slow_generate", new Method_factory<Method_function_adapter>(slow_generate));
+  ic.coalesce_method("slow_generate");
+
+  std::vector<Value> generated(3, Value(0));
+  boost::thread_group gen_threads;
+  for (size_t i = 0; i < generated.size(); ++i)
+    gen_threads.create_thread(Coalesced_call(disp, ic, generated[i], "slow_generate"));
+  gen_threads.join_all();
+
+  BOOST_CHECK_EQUAL(ic.coalesced(), 4u);
+  for (size_t i = 0; i < generated.size(); ++i)
+  {
+    BOOST_CHECK(!generated[i].is_generated_array());
+    BOOST_CHECK(generated[i] == generated[0]);
+
+    Response r = parse_response(dump_response(Response(new Value(generated[i]))));
+    BOOST_REQUIRE_EQUAL(r.value().size(), 3u);
+    BOOST_CHECK_EQUAL(r.value()[2].get_int(), 2);
+  }
+}
+
+namespace {
+
+int memo_calls = 0;
+
+void memo_struct(Method*, const Param_list& args, Value& retval)
+{
+  Struct s;
+  s.insert("arg", args[0]);
+  s.insert("calls", ++memo_calls);
+  retval = s;
+}
+
+void memo_generate(Method*, const Param_list&, Value& retval)
+{
+  ++memo_calls;
+  retval = Generated_array(new Slow_generator);
+}
+
+} // anonymous namespace
+
+// Runs interceptor in-process, as executor's threads do.
+BOOST_AUTO_TEST_CASE( memoizing_interceptor_test )
+{
+  Method_dispatcher_manager disp;
+  disp.register_method("memo_struct", new Method_factory<Method_function_adapter>(memo_struct));
+  disp.register_method("memo_generate", new Method_factory<Method_function_adapter>(memo_generate));
+
+  Memoizing_interceptor ic;
+  ic.cache_method("memo_struct");
+  ic.cache_method("memo_generate");
+
+  // Typed result is returned on both miss and hit.
+  Value miss(0), hit(0);
+  Method::Data data = { "memo_struct", iqnet::Inet_addr(), Server_feedback() };
+  std::auto_ptr<Method> m(disp.create_method(data));
+  m->process_execution(&ic, Param_list(1, "x"), miss);
+  m->process_execution(&ic, Param_list(1, "x"), hit);
+
+  BOOST_CHECK_EQUAL(ic.hits(), 1u);
+  BOOST_CHECK_EQUAL(memo_calls, 1);
+  BOOST_REQUIRE(miss.is_struct() && hit.is_struct());
+  BOOST_CHECK(hit == miss);
+  BOOST_CHECK(ic.memory_used() > 0);
+
+  // Changes of the caller's copy do not affect the cache.
+  hit["calls"] = 100;
+  Value again(0);
+  m->process_execution(&ic, Param_list(1, "x"), again);
+  BOOST_CHECK_EQUAL(again["calls"].get_int(), 1);
+
+  // Generated result is cached serialized and may be sent many times.
+  Method::Data gen_data = { "memo_generate", iqnet::Inet_addr(), Server_feedback() };
+  std::auto_ptr<Method> g(disp.create_method(gen_data));
+  for (int i = 0; i < 2; ++i)
+  {
+    Value r(0);
+    g->process_execution(&ic, Param_list(), r);
+    Response parsed = parse_response(dump_response(Response(new Value(r))));
+    BOOST_REQUIRE_EQUAL(parsed.value().size(), 3u);
+    BOOST_CHECK_EQUAL(parsed.value()[2].get_int(), 2);
+  }
+  BOOST_CHECK_EQUAL(memo_calls, 2);
+}
+
+namespace {
+
+struct Point {
+  int x;
+  int y;
+};
+
+int point_sum(const Point& p)
+{
+  return p.x + p.y;
+}
+
+} // anonymous namespace
+
+IQXMLRPC_STRUCT(Point, (x)(y))
+
+// Malformed parameters of typed methods are reported as invalid ones.
+BOOST_AUTO_TEST_CASE( typed_method_params_test )
+{
+  Typed_method_factory<int(const Point&)> factory(point_sum);
+  std::auto_ptr<Method> m(factory.create());
+
+  Struct p;
+  p.insert("x", 1);
+  p.insert("y", 2);
+
+  Value result(0);
+  m->process_execution(0, Param_list(1, p), result);
+  BOOST_CHECK_EQUAL(result.get_int(), 3);
+
+  p.erase("y");
+  BOOST_CHECK_THROW(m->process_execution(0, Param_list(1, p), result), Invalid_meth_params);
+  BOOST_CHECK_THROW(m->process_execution(0, Param_list(1, 1), result), Invalid_meth_params);
+}
+
 BOOST_AUTO_TEST_CASE( stop_server )
 {
   if (!test_config.stop_server())
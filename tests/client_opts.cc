@@ -14,6 +14,7 @@ Client_opts::Client_opts():
   proxy_port_(0),
   use_ssl_(false),
   stop_server_(false),
+  memoize_(false),
   timeout_(0),
   opts_()
 {
@@ -24,6 +25,7 @@ Client_opts::Client_opts():
     ("proxy-port", value<int>(&proxy_port_))
     ("use-ssl", value<bool>(&use_ssl_))
     ("stop-server", value<bool>(&stop_server_))
+    ("memoize", value<bool>(&memoize_))
     ("timeout", value<int>(&timeout_))
     ("server-finger", value<std::string>(&server_fingerprint_));
 }
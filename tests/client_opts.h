@@ -18,6 +18,7 @@
  *    --use-ssl
  *    --numthreads
  *    --timeout
+ *    --memoize (server caches results of count_calls)
  */
 class Client_opts {
 public:
@@ -34,6 +35,7 @@ private:
   int         proxy_port_;
   bool        use_ssl_;
   bool        stop_server_;
+  bool        memoize_;
   int         timeout_;
   std::string server_fingerprint_;
 
@@ -55,6 +57,7 @@ public:
   bool              proxy_set()   const { return proxy_port_; }
   bool              use_ssl()     const { return use_ssl_; }
   bool              stop_server() const { return stop_server_; }
+  bool              memoize()     const { return memoize_; }
   int               timeout()     const { return timeout_; }
 
 protected:
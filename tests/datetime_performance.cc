@@ -0,0 +1,47 @@
+#include <iostream>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include "libiqxmlrpc/value.h"
+#include "libiqxmlrpc/response.h"
+
+using namespace iqxmlrpc;
+using namespace boost::posix_time;
+
+// Array of audit-log like records with a timestamp each.
+void datetime_test(int records)
+{
+  ptime t1 = microsec_clock::universal_time();
+
+  Date_time now(false);
+  struct tm t = now.get_tm();
+  Array arr;
+
+  for (int i = 0; i < records; ++i) {
+    t.tm_sec = (i / 100) % 60; // a hundred events per second
+    arr.push_back(Date_time(&t));
+  }
+
+  ptime t2 = microsec_clock::universal_time();
+  std::string s = dump_response(Response(new Value(arr)));
+  ptime t3 = microsec_clock::universal_time();
+  Response r = parse_response(s);
+  ptime t4 = microsec_clock::universal_time();
+
+  size_t total = 0;
+  const Value& v = r.value();
+  for (Array::const_iterator i = v.arr_begin(); i != v.arr_end(); ++i)
+    total += i->get_datetime().to_string().length();
+
+  ptime t5 = microsec_clock::universal_time();
+
+  std::cout << "Records " << records << " (" << s.length() << " bytes)" << std::endl;
+  std::cout << "Build time  " << (t2 - t1).total_milliseconds() << "ms" << std::endl;
+  std::cout << "Dump time   " << (t3 - t2).total_milliseconds() << "ms" << std::endl;
+  std::cout << "Parse time  " << (t4 - t3).total_milliseconds() << "ms" << std::endl;
+  std::cout << "Format time " << (t5 - t4).total_milliseconds() << "ms" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+  datetime_test(argc > 1 ? atoi(argv[1]) : 300000);
+  return 0;
+}
@@ -3,7 +3,9 @@
 #include <fstream>
 #include <openssl/md5.h>
 #include <boost/test/test_tools.hpp>
+#include <boost/thread/mutex.hpp>
 #include "libiqxmlrpc/server.h"
+#include "libiqxmlrpc/typed_method.h"
 #include "methods.h"
 
 using namespace iqxmlrpc;
@@ -15,7 +17,11 @@ void register_user_methods(iqxmlrpc::Server& s)
   register_method(s, "echo_user", echo_user);
   register_method(s, "error_method", error_method);
   register_method(s, "trace", trace_method);
+  register_method(s, "count_calls", count_calls);
   register_method<Get_file>(s, "get_file");
+  register_method<Sum_streamed>(s, "sum_streamed");
+  register_method<Generate_rows>(s, "generate_rows");
+  register_method<double(double, const std::vector<double>&)>(s, "scale_sum", scale_sum);
 }
 
 void serverctl_stop::execute( 
@@ -63,6 +69,20 @@ void echo_user(
   retval = m->authname();
 }
 
+void count_calls(
+  iqxmlrpc::Method*,
+  const iqxmlrpc::Param_list&,
+  iqxmlrpc::Value& retval )
+{
+  BOOST_TEST_MESSAGE("count_calls method invoked.");
+
+  static boost::mutex lock;
+  static int calls = 0;
+
+  boost::mutex::scoped_lock lk(lock);
+  retval = ++calls;
+}
+
 void error_method(
   iqxmlrpc::Method* m,
   const iqxmlrpc::Param_list&,
@@ -107,3 +127,50 @@ void Get_file::execute(
   retval.insert("md5", Binary_data::from_data(
     reinterpret_cast<strchar*>(md5), sizeof(md5)));
 }
+
+void Sum_streamed::execute_streamed( iqxmlrpc::Value& retval )
+{
+  BOOST_TEST_MESSAGE("Sum_streamed method invoked.");
+  retval = sum_;
+}
+
+namespace
+{
+  class Rows_generator: public iqxmlrpc::Array_generator {
+  public:
+    Rows_generator(int n): n_(n), i_(0) {}
+
+    iqxmlrpc::Value* next()
+    {
+      if (i_ == n_)
+        return 0;
+
+      iqxmlrpc::Struct row;
+      row.insert("id", i_);
+      row.insert("name", "row");
+      ++i_;
+      return new iqxmlrpc::Value(row);
+    }
+
+  private:
+    int n_;
+    int i_;
+  };
+}
+
+void Generate_rows::execute(
+  const iqxmlrpc::Param_list& args, iqxmlrpc::Value& retval )
+{
+  BOOST_TEST_MESSAGE("Generate_rows method invoked.");
+  retval = Generated_array(new Rows_generator(args[0].get_int()));
+}
+
+double scale_sum(double factor, const std::vector<double>& values)
+{
+  BOOST_TEST_MESSAGE("scale_sum method invoked.");
+  double sum = 0;
+  for (size_t i = 0; i < values.size(); ++i)
+    sum += values[i];
+
+  return sum * factor;
+}
@@ -21,4 +21,29 @@ public:
   void execute( const iqxmlrpc::Param_list&, iqxmlrpc::Value& );
 };
 
+//! Sums all numbers found in parameters without building them.
+class Sum_streamed: public iqxmlrpc::Streaming_method {
+public:
+  Sum_streamed(): sum_(0) {}
+
+private:
+  void do_visit_int(int i) { sum_ += i; }
+  void do_visit_double(double d) { sum_ += d; }
+  void execute_streamed( iqxmlrpc::Value& );
+
+  double sum_;
+};
+
+//! Typed method: multiplies sum of values by factor.
+double scale_sum(double factor, const std::vector<double>& values);
+
+//! Returns number of its executions. Server caches its results.
+void count_calls(iqxmlrpc::Method*, const iqxmlrpc::Param_list&, iqxmlrpc::Value&);
+
+//! Returns requested number of rows produced by Array_generator.
+class Generate_rows: public iqxmlrpc::Method {
+public:
+  void execute( const iqxmlrpc::Param_list&, iqxmlrpc::Value& );
+};
+
 #endif
@@ -1,13 +1,22 @@
 #define BOOST_TEST_MODULE test_parser
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <algorithm>
+#include <boost/lexical_cast.hpp>
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test.hpp>
+#include <libxml/xmlwriter.h>
+#include "libiqxmlrpc/connection.h"
+#include "libiqxmlrpc/http.h"
+#include "libiqxmlrpc/params_visitor.h"
 #include "libiqxmlrpc/value.h"
 #include "libiqxmlrpc/value_parser.h"
+#include "libiqxmlrpc/value_type_visitor.h"
 #include "libiqxmlrpc/request_parser.h"
 #include "libiqxmlrpc/response_parser.h"
+#include "libiqxmlrpc/response_serializer.h"
+#include "libiqxmlrpc/xml_builder.h"
 
 using namespace boost::unit_test;
 using namespace iqxmlrpc;
@@ -100,6 +109,45 @@ BOOST_AUTO_TEST_CASE(test_parse_simple_struct)
   BOOST_CHECK_EQUAL(s[""].get_string(), "str2");
 }
 
+BOOST_AUTO_TEST_CASE(test_parse_unsorted_struct)
+{
+  Value v = parse_value(
+    "<struct>"
+      "<member><name>c</name><value><int>1</int></value></member>"
+      "<member><name>a</name><value><int>2</int></value></member>"
+      "<member><name>c</name><value><int>3</int></value></member>"
+      "<member><name>b</name><value><int>4</int></value></member>"
+    "</struct>");
+
+  // The last of duplicated members wins.
+  const Struct& s = v.the_struct();
+  BOOST_REQUIRE_EQUAL(s.size(), 3);
+  BOOST_CHECK_EQUAL(s["a"].get_int(), 2);
+  BOOST_CHECK_EQUAL(s["b"].get_int(), 4);
+  BOOST_CHECK_EQUAL(s["c"].get_int(), 3);
+  BOOST_CHECK_EQUAL(s.begin()->first, "a");
+
+  Struct e;
+  e.insert("b", 4);
+  e.insert("a", 2);
+  e.insert("c", 3);
+  BOOST_CHECK(v == Value(e));
+  BOOST_CHECK_EQUAL(v.hash(), Value(e).hash());
+
+  // Large struct in reverse order is sorted once.
+  std::string big = "<struct>";
+  for (int i = 50000; i > 0; --i)
+  {
+    std::string n = boost::lexical_cast<std::string>(i);
+    big += "<member><name>" + n + "</name><value><int>" + n + "</int></value></member>";
+  }
+  big += "</struct>";
+
+  Value b = parse_value(big);
+  BOOST_CHECK_EQUAL(b.the_struct().size(), 50000);
+  BOOST_CHECK_EQUAL(b["777"].get_int(), 777);
+}
+
 BOOST_AUTO_TEST_CASE(test_parse_nested_struct)
 {
   Struct s = parse_value(
@@ -239,6 +287,40 @@ BOOST_AUTO_TEST_CASE(test_malfromed_value)
   BOOST_CHECK_THROW(parse_value("<string>OK<MALFORMED/></string>"), XML_RPC_violation);
 }
 
+BOOST_AUTO_TEST_CASE(test_parser_reuse)
+{
+  // parser state is reused after failures
+  for (int i = 0; i < 10; ++i) {
+    BOOST_CHECK_THROW(parse_value("<int>1</i4>"), Parse_error);
+    BOOST_CHECK_THROW(parse_value("<int><x/></int>"), XML_RPC_violation);
+    BOOST_CHECK_EQUAL(parse_value("<int>" + boost::lexical_cast<std::string>(i) + "</int>").get_int(), i);
+  }
+
+  // reader is recreated periodically, so names with unique tags
+  // do not pile up in its dictionary
+  for (int i = 0; i < 2500; ++i) {
+    std::string tag = "t" + boost::lexical_cast<std::string>(i);
+    BOOST_CHECK_THROW(parse_value("<" + tag + ">1</" + tag + ">"), XML_RPC_violation);
+  }
+  BOOST_CHECK_EQUAL(parse_value("<int>7</int>").get_int(), 7);
+
+  // entities are still not substituted by reused parser
+  std::string xxe = "<!DOCTYPE x [<!ENTITY e \"injected\">]><string>&e;</string>";
+  BOOST_CHECK(parse_value(xxe).get_string().find("injected") == std::string::npos);
+  BOOST_CHECK(parse_value(xxe).get_string().find("injected") == std::string::npos);
+
+  // nested parsers do not share state
+  Parser outer("<array><data><value><i4>1</i4></value><value><i4>2</i4></value></data></array>");
+  ValueBuilder ob(outer);
+  for (int i = 0; i < 3; ++i)
+    BOOST_CHECK_EQUAL(parse_value("<a:string xmlns:a=\"x\">nested</a:string>").get_string(), "nested");
+
+  ob.build();
+  Value arr(ob.result());
+  BOOST_CHECK_EQUAL(arr.size(), 2);
+  BOOST_CHECK_EQUAL(arr[1].get_int(), 2);
+}
+
 //
 // request
 //
@@ -316,6 +398,89 @@ BOOST_AUTO_TEST_CASE(test_parse_malformed_request)
   BOOST_CHECK_THROW(parse_request(r), XML_RPC_violation);
 }
 
+class Events_recorder: public Params_visitor {
+public:
+  std::string events;
+
+private:
+  void do_visit_param(size_t i) { add("P" + boost::lexical_cast<std::string>(i)); }
+  void do_visit_nil() { add("nil"); }
+  void do_visit_int(int i) { add(boost::lexical_cast<std::string>(i)); }
+  void do_visit_int64(int64_t i) { add(boost::lexical_cast<std::string>(i) + "L"); }
+  void do_visit_double(double d) { add(boost::lexical_cast<std::string>(d) + "D"); }
+  void do_visit_bool(bool b) { add(b ? "true" : "false"); }
+  void do_visit_string(const std::string& s) { add("'" + s + "'"); }
+  void do_visit_base64(const Binary_data& b) { add("b:" + b.get_data()); }
+  void do_visit_datetime(const Date_time& d) { add("t:" + d.to_string()); }
+  void do_visit_array_begin() { add("["); }
+  void do_visit_array_end() { add("]"); }
+  void do_visit_struct_begin() { add("{"); }
+  void do_visit_member(const std::string& n) { add(n + ":"); }
+  void do_visit_struct_end() { add("}"); }
+
+  void add(const std::string& s)
+  {
+    events += events.empty() ? s : " " + s;
+  }
+};
+
+BOOST_AUTO_TEST_CASE(test_stream_request_params)
+{
+  std::string r = "<?xml version=\"1.0\"?>\
+    <methodCall>\
+      <methodName>streamed</methodName>\
+      <params>\
+        <param><value><i4>1</i4></value></param>\
+        <param><value>str</value></param>\
+        <param><value/></param>\
+        <param><value>\
+          <struct>\
+            <member><name>a</name><value><array><data>\
+              <value><i8>5000000000</i8></value>\
+              <value><double>0.5</double></value>\
+              <value><nil/></value>\
+              <value><array><data></data></array></value>\
+            </data></array></value></member>\
+            <member><name>b</name><value><boolean>1</boolean></value></member>\
+            <member><name>c</name><value><base64>YWJj</base64></value></member>\
+            <member><name>d</name><value><dateTime.iso8601>19980717T14:08:55</dateTime.iso8601></value></member>\
+          </struct>\
+        </value></param>\
+        <param><value><string>last</string></value></param>\
+      </params>\
+    </methodCall>";
+
+  Request_stream rs(r);
+  BOOST_CHECK_EQUAL(rs.method_name(), "streamed");
+
+  Events_recorder rec;
+  rs.stream_params(rec);
+  BOOST_CHECK_EQUAL(rec.events,
+    "P0 1 P1 'str' P2 '' P3 { a: [ 5000000000L 0.5D nil [ ] ] "
+    "b: true c: b:abc d: t:19980717T14:08:55 } P4 'last'");
+
+  // the same request can be built as usual
+  Request_stream rs2(r);
+  std::auto_ptr<Request> req(rs2.get_request());
+  BOOST_CHECK_EQUAL(req->get_name(), "streamed");
+  BOOST_CHECK_EQUAL(req->get_params().size(), 5u);
+  BOOST_CHECK_EQUAL(req->get_params()[3]["a"][0].get_int64(), 5000000000L);
+  BOOST_CHECK(req->get_params()[3]["a"][2].is_nil());
+  BOOST_CHECK_EQUAL(req->get_params()[3]["d"].get_datetime().to_string(), "19980717T14:08:55");
+}
+
+BOOST_AUTO_TEST_CASE(test_stream_request_errors)
+{
+  BOOST_CHECK_THROW(Request_stream("<methodCall><params/></methodCall>"), XML_RPC_violation);
+
+  Request_stream rs("<methodCall><methodName>m</methodName><params>"
+    "<param><value><struct><member><value>1</value></member></struct></value></param>"
+    "</params></methodCall>");
+
+  Events_recorder rec;
+  BOOST_CHECK_THROW(rs.stream_params(rec), XML_RPC_violation);
+}
+
 //
 // response
 //
@@ -405,4 +570,616 @@ BOOST_AUTO_TEST_CASE(test_parse_fault_response)
   BOOST_CHECK_EQUAL(res.fault_string(), "Out of beer");
 }
 
+//
+// lazy response
+//
+
+namespace {
+
+boost::shared_ptr<const std::string>
+lazy_buf(const std::string& s)
+{
+  return boost::shared_ptr<const std::string>(new std::string(s));
+}
+
+const char* lazy_ok_response = "<?xml version=\"1.0\"?>\
+<methodResponse><params><param><value><struct>\
+ <member><name>temp</name><value><double>15.5</double></value></member>\
+ <member><name>list</name><value><array><data>\
+   <value><i4>1</i4></value>\
+   <value>two &amp; &#x442;</value>\
+   <value><nil/></value>\
+   <value><array><data><value><boolean>1</boolean></value></data></array></value>\
+   <value><struct><member><name>x</name><value><int>5</int></value></member></struct></value>\
+   <value><string>&lt;tag&gt;</string></value>\
+ </data></array></value></member>\
+ <member><name>bad</name><value><int><foo/>1</int></value></member>\
+ <member><name>empty</name><value/></member>\
+</struct></value></param></params></methodResponse>";
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_parse_lazy_response)
+{
+  Response res = parse_response_lazy(lazy_buf(lazy_ok_response));
+  BOOST_REQUIRE(!res.is_fault());
+
+  const Value& v = res.value();
+  BOOST_REQUIRE(v.is_struct());
+  BOOST_CHECK_EQUAL(v.the_struct().size(), 4);
+  BOOST_CHECK(v.has_field("bad"));
+  BOOST_CHECK_EQUAL(v["temp"].get_double(), 15.5);
+  BOOST_CHECK_EQUAL(v["empty"].get_string(), "");
+
+  const Value& list = v["list"];
+  BOOST_REQUIRE(list.is_array());
+  BOOST_CHECK_EQUAL(list.size(), 6);
+  BOOST_CHECK_EQUAL(list[0].get_int(), 1);
+  BOOST_CHECK_EQUAL(list[1].get_string(), "two & \xd1\x82");
+  BOOST_CHECK(list[2].is_nil());
+  BOOST_CHECK_EQUAL(list[3][0].get_bool(), true);
+  BOOST_CHECK_EQUAL(list[4]["x"].get_int(), 5);
+  BOOST_CHECK_EQUAL(list[5].get_string(), "<tag>");
+  BOOST_CHECK_THROW(list[6], Array::Out_of_range);
+
+  // malformed elements are reported on access only
+  BOOST_CHECK_THROW(v["bad"], XML_RPC_violation);
+  BOOST_CHECK_THROW(v["nope"], Struct::No_field);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_response_iteration)
+{
+  Response res = parse_response_lazy(lazy_buf(lazy_ok_response));
+  const Array& a = res.value()["list"].the_array();
+
+  int n = 0;
+  for (Array::const_iterator i = a.begin(); i != a.end(); ++i, ++n)
+    BOOST_CHECK_EQUAL(i->type_name(), a[n].type_name());
+
+  BOOST_CHECK_EQUAL(n, 6);
+
+  Struct s(res.value()["list"][4].the_struct());
+  BOOST_CHECK_EQUAL(s.begin()->first, "x");
+  BOOST_CHECK_EQUAL(s.begin()->second->get_int(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_response_copy)
+{
+  Value copy = Nil();
+  {
+    Response res = parse_response_lazy(lazy_buf(lazy_ok_response));
+    BOOST_CHECK_EQUAL(res.value()["temp"].get_double(), 15.5);
+    copy = res.value();
+  }
+
+  // copy keeps buffer alive and decodes rest of elements independently
+  BOOST_CHECK_EQUAL(copy["temp"].get_double(), 15.5);
+  BOOST_CHECK_EQUAL(copy["list"][1].get_string(), "two & \xd1\x82");
+  BOOST_CHECK_THROW(copy["bad"], XML_RPC_violation);
+
+  Value list = copy["list"];
+  list.push_back(Value(7));
+  BOOST_CHECK_EQUAL(list.size(), 7);
+  BOOST_CHECK_EQUAL(list[6].get_int(), 7);
+  BOOST_CHECK_EQUAL(list[0].get_int(), 1);
+  BOOST_CHECK_EQUAL(copy["list"].size(), 6);
+
+  copy.the_struct().erase("bad");
+  BOOST_CHECK(!copy.has_field("bad"));
+  BOOST_CHECK_EQUAL(copy.the_struct().size(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_response_fallback)
+{
+  std::string r = "<methodResponse><fault><value><struct>\
+<member><name>faultCode</name><value><int>143</int></value></member>\
+<member><name>faultString</name><value>Out of beer</value></member>\
+</struct></value></fault></methodResponse>";
+
+  Response res = parse_response_lazy(lazy_buf(r));
+  BOOST_CHECK(res.is_fault());
+  BOOST_CHECK_EQUAL(res.fault_code(), 143);
+
+  std::string e = "<methodResponse><params><param><value>  </value>\
+</param></params></methodResponse>";
+  BOOST_CHECK_EQUAL(parse_response_lazy(lazy_buf(e)).value().get_string(), "");
+
+  std::string m = "<methodResponse><params><param><value><array><data>\
+<value><int>1</int></value><foo/></data></array></value>\
+</param></params></methodResponse>";
+  BOOST_CHECK_THROW(parse_response_lazy(lazy_buf(m)), XML_RPC_violation);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_response_document_check)
+{
+  // Errors deep in elements which are never accessed are found up front.
+  std::string m = "<methodResponse><params><param><value><array><data>\
+<value><struct><member><name>a</name><value>1</value></memb></struct></value>\
+</data></array></value></param></params></methodResponse>";
+  BOOST_CHECK_THROW(parse_response_lazy(lazy_buf(m)), Parse_error);
+
+  std::string r = "<methodResponse><params><param><value><array><data>\
+<value>&bogus;</value></data></array></value></param></params></methodResponse>";
+  BOOST_CHECK_THROW(parse_response_lazy(lazy_buf(r)), Parse_error);
+
+  // Content after the value is checked as well.
+  std::string t = "<methodResponse><params><param><value><array><data>\
+<value>1</value></data></array></value></param></params>";
+  BOOST_CHECK_THROW(parse_response_lazy(lazy_buf(t)), Parse_error);
+
+  std::string p = "<methodResponse><params><param><value>1</value></param>\
+<param><value>2</value></param></params></methodResponse>";
+  BOOST_CHECK_THROW(parse_response_lazy(lazy_buf(p)), XML_RPC_violation);
+}
+
+BOOST_AUTO_TEST_CASE(test_lazy_response_text)
+{
+  std::string doc = "<?xml version=\"1.0\" encoding=\"ISO-8859-1\"?>\
+<methodResponse><params><param><value><array><data>\
+<value>caf\xe9</value>\
+<value><string>a\r\nb&#13;&lt;</string></value>\
+<value><string> </string></value>\
+<value><i4>7</i4></value>\
+</data></array></value></param></params></methodResponse>";
+
+  Response lazy = parse_response_lazy(lazy_buf(doc));
+  Response eager = parse_response(doc);
+
+  const Value& v = lazy.value();
+  BOOST_CHECK_EQUAL(v[0].get_string(), "caf\xc3\xa9");
+  BOOST_CHECK_EQUAL(v[1].get_string(), "a\nb\r<");
+  BOOST_CHECK_EQUAL(v[2].get_string(), "");
+  BOOST_CHECK_EQUAL(v[3].get_int(), 7);
+  BOOST_CHECK(v == eager.value());
+}
+
+//
+// xml builder
+//
+
+namespace {
+
+// Reference output of libxml2's writer.
+std::string
+libxml_text_document(const std::string& text)
+{
+  xmlBufferPtr buf = xmlBufferCreate();
+  xmlTextWriterPtr w = xmlNewTextWriterMemory(buf, 0);
+  xmlTextWriterStartDocument(w, NULL, "UTF-8", NULL);
+  xmlTextWriterStartElement(w, BAD_CAST "a");
+  xmlTextWriterStartElement(w, BAD_CAST "b");
+  xmlTextWriterEndElement(w);
+  xmlTextWriterStartElement(w, BAD_CAST "s");
+  xmlTextWriterWriteString(w, BAD_CAST text.c_str());
+  xmlTextWriterEndElement(w);
+  xmlTextWriterEndDocument(w);
+  xmlFreeTextWriter(w);
+
+  std::string retval(reinterpret_cast<const char*>(xmlBufferContent(buf)), buf->use);
+  xmlBufferFree(buf);
+  return retval;
+}
+
+std::string
+text_document(const std::string& text)
+{
+  XmlBuilder w;
+  XmlBuilder::Node a(w, "a");
+  { XmlBuilder::Node b(w, "b"); }
+  { XmlBuilder::Node s(w, "s"); s.set_textdata(text); }
+  w.stop();
+
+  std::string retval;
+  w.swap_content(retval);
+  return retval;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_xml_builder_escaping)
+{
+  for (int c = 0; c < 256; ++c) {
+    std::string s = "0123456789abcdef0123456789";
+    s[17] = static_cast<char>(c);
+    BOOST_CHECK_EQUAL(text_document(s), libxml_text_document(s));
+    BOOST_CHECK_EQUAL(text_document(s.substr(17, 1)), libxml_text_document(s.substr(17, 1)));
+  }
+
+  const char alpha[] = "<>&\"'\r\n\t ]abc\xd1\x82\xff";
+  srand(7);
+  for (int i = 0; i < 1000; ++i) {
+    std::string s(rand() % 100, ' ');
+    for (size_t j = 0; j < s.size(); ++j)
+      s[j] = alpha[rand() % (sizeof(alpha) - 1)];
+
+    BOOST_CHECK_EQUAL(text_document(s), libxml_text_document(s));
+  }
+}
+
+//
+// chunked responses
+//
+
+BOOST_AUTO_TEST_CASE(test_response_serializer)
+{
+  Array arr;
+  arr.push_back(Array());
+  arr.push_back(Struct());
+  for (int i = 0; i < 300; ++i) {
+    Struct s;
+    s.insert("id", i);
+    s.insert("nested", Array());
+    s["nested"].push_back("a & b");
+    s["nested"].push_back(Nil());
+    arr.push_back(s);
+  }
+
+  Response responses[] = {
+    Response(new Value(arr)),
+    Response(new Value("scalar")),
+    Response(new Value(Struct())),
+    Response(13, "fault")
+  };
+
+  const size_t chunk_sizes[] = { 1, 100, 4096, 1024*1024 };
+
+  for (size_t i = 0; i < sizeof(responses)/sizeof(responses[0]); ++i) {
+    for (size_t j = 0; j < sizeof(chunk_sizes)/sizeof(chunk_sizes[0]); ++j) {
+      Response_serializer s(responses[i], chunk_sizes[j]);
+      std::string doc, chunk;
+      bool more = true;
+      size_t num = 0;
+
+      for (; more; ++num) {
+        more = s.next_chunk(chunk);
+        doc += chunk;
+      }
+
+      BOOST_CHECK_EQUAL(doc, dump_response(responses[i]));
+      if (i == 0 && chunk_sizes[j] == 4096)
+        BOOST_CHECK(num > 1);
+    }
+  }
+}
+
+namespace {
+
+class Counting_generator: public Array_generator {
+public:
+  Counting_generator(int n): n_(n), i_(0) {}
+
+  Value* next()
+  {
+    if (i_ == n_)
+      return 0;
+
+    Array a;
+    a.push_back(i_++);
+    return new Value(a);
+  }
+
+private:
+  int n_;
+  int i_;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_serialize_generated_array)
+{
+  Array expected;
+  for (int i = 0; i < 1000; ++i) {
+    Array a;
+    a.push_back(i);
+    expected.push_back(a);
+  }
+
+  const std::string expected_xml = dump_response(Response(new Value(expected)));
+
+  Value generated = Generated_array(new Counting_generator(1000));
+  BOOST_CHECK(!generated.is_array());
+  BOOST_CHECK(generated.is_generated_array());
+  BOOST_CHECK_EQUAL(dump_response(Response(new Value(generated))), expected_xml);
+
+  Response_serializer s(Response(new Value(Generated_array(new Counting_generator(1000)))), 256);
+  std::string doc, chunk;
+  for (bool more = true; more;) {
+    more = s.next_chunk(chunk);
+    doc += chunk;
+  }
+  BOOST_CHECK_EQUAL(doc, expected_xml);
+
+  // Visitors that do not support generated arrays receive Array.
+  std::ostringstream printed, printed_expected;
+  Print_value_visitor p(printed);
+  Value(Generated_array(new Counting_generator(3))).apply_visitor(p);
+  Array first;
+  Array::const_iterator last = expected.begin();
+  std::advance(last, 3);
+  first.assign(expected.begin(), last);
+  Print_value_visitor pe(printed_expected);
+  Value(first).apply_visitor(pe);
+  BOOST_CHECK_EQUAL(printed.str(), printed_expected.str());
+}
+
+BOOST_AUTO_TEST_CASE(test_raw_xml_value)
+{
+  Struct catalog;
+  catalog.insert("name", "a < b & c");
+  catalog.insert("empty", "");
+  catalog.insert("nil", Nil());
+  catalog.insert("list", Array());
+  catalog["list"].push_back(1);
+  catalog["list"].push_back(2.5);
+  catalog["list"].push_back(Struct());
+
+  Value raw(Raw_xml_value::from_value(catalog));
+  BOOST_CHECK_EQUAL(raw.type_name(), "struct");
+  BOOST_CHECK(!raw.is_struct());
+
+  BOOST_CHECK_EQUAL(
+    dump_response(Response(new Value(raw))),
+    dump_response(Response(new Value(catalog))));
+
+  // Fragment can be nested into regular values.
+  Array wrapped, expected;
+  wrapped.push_back(raw);
+  wrapped.push_back(Raw_xml_value::from_value(Value("")));
+  expected.push_back(catalog);
+  expected.push_back("");
+
+  Response_serializer s(Response(new Value(wrapped)), 16);
+  std::string doc, chunk;
+  for (bool more = true; more;) {
+    more = s.next_chunk(chunk);
+    doc += chunk;
+  }
+  BOOST_CHECK_EQUAL(doc, dump_response(Response(new Value(expected))));
+
+  // Other visitors see the parsed value.
+  std::ostringstream printed, printed_expected;
+  Print_value_visitor p(printed);
+  raw.apply_visitor(p);
+  Print_value_visitor pe(printed_expected);
+  Value(catalog).apply_visitor(pe);
+  BOOST_CHECK_EQUAL(printed.str(), printed_expected.str());
+}
+
+BOOST_AUTO_TEST_CASE(test_parallel_serialization)
+{
+  Array arr;
+  for (int i = 0; i < 2000; ++i) {
+    Struct s;
+    s.insert("id", i);
+    s.insert("text", "a & b");
+    s.insert("nested", Array());
+    for (int j = 0; j < i % 200; ++j)
+      s["nested"].push_back(j);
+    arr.push_back(s);
+  }
+  arr.push_back(Array());
+
+  Response r(new Value(arr));
+  const std::string serial = dump_response(r);
+  Param_list params(1, arr);
+  const std::string serial_req = dump_request(Request("m", params));
+
+  boost::shared_ptr<const std::string> buf(new std::string(serial));
+  Response lazy = parse_response_lazy(buf);
+
+  for (unsigned threads = 1; threads < 4; ++threads) {
+    Value::set_parallel_serialization(threads, 100);
+    BOOST_CHECK(dump_response(r) == serial);
+    BOOST_CHECK(dump_request(Request("m", params)) == serial_req);
+    BOOST_CHECK(dump_response(lazy) == serial);
+  }
+
+  Value::set_parallel_serialization(0);
+  BOOST_CHECK(dump_response(r) == serial);
+}
+
+BOOST_AUTO_TEST_CASE(test_dump_size)
+{
+  Struct st;
+  st.insert("escaped <name>", "a < b & \"c\"\r\n");
+  st.insert("empty", "");
+  st.insert("nil", Nil());
+  st.insert("ints", Array());
+  st["ints"].push_back(0);
+  st["ints"].push_back(-7);
+  st["ints"].push_back(2147483647);
+  st["ints"].push_back(-2147483647 - 1);
+  st["ints"].push_back(int64_t(-9223372036854775807LL));
+  st.insert("doubles", Array());
+  st["doubles"].push_back(0.1);
+  st["doubles"].push_back(-1.2345678901234567e-308);
+  st["doubles"].push_back(1e300);
+  st.insert("bool", true);
+  st.insert("empty struct", Struct());
+  st.insert("empty array", Array());
+  st.insert("bin", Binary_data::from_data("binary\0data", 11));
+  st.insert("empty bin", Binary_data::from_data(""));
+  st.insert("date", Date_time(std::string("20111015T10:20:30")));
+  st.insert("raw", Raw_xml_value::from_value(Value("raw & text")));
+  st.insert("nul", std::string("before\0after", 12));
+
+  Value values[] = { st, Value(""), Value(Array()), Value(1.5) };
+
+  for (int omit = 0; omit < 2; ++omit) {
+    Value::omit_string_tag_in_responses(omit);
+
+    for (size_t i = 0; i < sizeof(values)/sizeof(values[0]); ++i) {
+      Response r(new Value(values[i]));
+      BOOST_CHECK_EQUAL(dump_response_size(r).get(), dump_response(r).size());
+
+      Param_list params;
+      Request empty_req("method & <name>", params);
+      BOOST_CHECK_EQUAL(dump_request_size(empty_req).get(), dump_request(empty_req).size());
+
+      params.push_back(values[i]);
+      params.push_back(values[i]);
+      Request req("method", params);
+      BOOST_CHECK_EQUAL(dump_request_size(req).get(), dump_request(req).size());
+    }
+  }
+
+  Value::omit_string_tag_in_responses(false);
+
+  Response fault(123, "fault & <reason>");
+  BOOST_CHECK_EQUAL(dump_response_size(fault).get(), dump_response(fault).size());
+
+  Response generated(new Value(Generated_array(new Counting_generator(3))));
+  BOOST_CHECK(!dump_response_size(generated));
+}
+
+BOOST_AUTO_TEST_CASE(test_packed_arrays)
+{
+  const char* arrays[] = {
+    "<array><data><value><double>1.5</double></value><value><double>-2</double></value></data></array>",
+    "<array><data><value><i4>1</i4></value><value><int>2</int></value></data></array>",
+    "<array><data><value><i8>5000000000</i8></value></data></array>",
+    "<array><data><value><boolean>1</boolean></value><value><boolean>0</boolean></value></data></array>",
+    "<array><data><value><i4>1</i4></value><value><double>2.5</double></value><value>s</value></data></array>",
+    "<array><data></data></array>"
+  };
+
+  for (size_t i = 0; i < sizeof(arrays)/sizeof(arrays[0]); ++i) {
+    Value regular = parse_value(arrays[i]);
+    Value::pack_numeric_arrays(true);
+    Value packed = parse_value(arrays[i]);
+    Value::pack_numeric_arrays(false);
+
+    BOOST_CHECK(regular.is_array());
+    BOOST_CHECK(!regular.the_array().packed());
+    BOOST_REQUIRE(packed.is_array());
+    BOOST_CHECK_EQUAL(packed.the_array().packed() != 0, i < 4);
+
+    // Output is the same for both representations.
+    Response r1(new Value(regular));
+    Response r2(new Value(packed));
+    BOOST_CHECK_EQUAL(dump_response(r1), dump_response(r2));
+    BOOST_CHECK_EQUAL(dump_response_size(r2).get(), dump_response(r2).size());
+
+    std::ostringstream s1, s2;
+    print_value(regular, s1);
+    print_value(packed, s2);
+    BOOST_CHECK_EQUAL(s1.str(), s2.str());
+    BOOST_CHECK(regular == packed);
+  }
+
+  Value::pack_numeric_arrays(true);
+  Value v = parse_value(arrays[0]);
+  Value::pack_numeric_arrays(false);
+
+  const Value& cv = v;
+  const Double_array* da = cv.the_array().packed_as<double>();
+  BOOST_REQUIRE(da);
+  BOOST_REQUIRE_EQUAL(da->size(), 2u);
+  BOOST_CHECK_EQUAL(da->data()[0], 1.5);
+  BOOST_CHECK_EQUAL((*da)[1], -2);
+  BOOST_CHECK(!cv.the_array().packed_as<int>());
+
+  // Regular array interface works and const access keeps elements packed.
+  BOOST_CHECK_EQUAL(cv.size(), 2u);
+  BOOST_CHECK_EQUAL(cv[0].get_double(), 1.5);
+  BOOST_CHECK_EQUAL(cv.arr_begin()->get_double(), 1.5);
+  BOOST_CHECK_EQUAL(std::distance(cv.arr_begin(), cv.arr_end()), 2);
+  BOOST_CHECK_THROW(cv[2], Array::Out_of_range);
+  BOOST_CHECK(cv.the_array().packed());
+
+  // Modification unpacks private copy only.
+  Value copy = v;
+  copy[1] = "x";
+  BOOST_CHECK(!copy.the_array().packed());
+  BOOST_CHECK_EQUAL(copy[1].get_string(), "x");
+  BOOST_CHECK_EQUAL(copy[0].get_double(), 1.5);
+  BOOST_CHECK(cv.the_array().packed());
+  BOOST_CHECK_EQUAL(cv[1].get_double(), -2);
+
+  v.push_back(3.0);
+  BOOST_CHECK(!cv.the_array().packed());
+  BOOST_CHECK_EQUAL(cv.size(), 3u);
+  BOOST_CHECK_EQUAL(cv[2].get_double(), 3.0);
+
+  int ints[] = { 1, 2, 3 };
+  Int_array* ia = new Int_array(ints, 3);
+  ia->push_back(4);
+  Value vi(new Array(ia));
+  BOOST_CHECK_EQUAL(vi.the_array().packed_as<int>()->data()[3], 4);
+  BOOST_CHECK_EQUAL(vi[3].get_int(), 4);
+  BOOST_CHECK_EQUAL(vi.type_name(), "array");
+}
+
+namespace {
+
+http::Packet*
+read_in_pieces(http::Packet_reader& r, const std::string& s, size_t piece)
+{
+  http::Packet* p = 0;
+  for (size_t i = 0; i < s.size() && !p; i += piece)
+    p = r.read_response(s.substr(i, piece), false);
+
+  return p;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(test_read_chunked_response)
+{
+  const std::string pkt =
+    "HTTP/1.1 200 OK\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Content-Type: text/xml\r\n"
+    "\r\n"
+    "5\r\nHello\r\n"
+    "1;name=value\r\n,\r\n"
+    "00B\r\n chunked wo\r\n"
+    "3\r\nrld\r\n"
+    "0\r\n"
+    "X-Trailer: 1\r\n"
+    "\r\n";
+
+  for (size_t piece = 1; piece <= pkt.size(); ++piece) {
+    http::Packet_reader r;
+    std::auto_ptr<http::Packet> p(read_in_pieces(r, pkt, piece));
+    BOOST_REQUIRE(p.get());
+    BOOST_CHECK_EQUAL(p->content(), "Hello, chunked world");
+  }
+
+  http::Packet_reader bad_sz;
+  BOOST_CHECK_THROW(
+    bad_sz.read_response("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n", false),
+    http::Malformed_packet);
+
+  http::Packet_reader bad_end;
+  BOOST_CHECK_THROW(
+    bad_end.read_response("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nabc\r\n", false),
+    http::Malformed_packet);
+}
+
+BOOST_AUTO_TEST_CASE(test_dump_chunked_packet)
+{
+  iqnet::Send_queue q;
+  http::Packet p(new http::Response_header(), "first");
+  p.set_chunked();
+  p.dump(q);
+
+  std::string rest("second");
+  http::dump_chunk(q, rest);
+  std::string last;
+  http::dump_chunk(q, last);
+
+  std::string out;
+  for (; !q.empty(); q.advance(q.front().size))
+    out.append(q.front().data, q.front().size);
+
+  BOOST_CHECK(out.find("content-length") == std::string::npos);
+  BOOST_CHECK(out.find("transfer-encoding: chunked\r\n") != std::string::npos);
+
+  http::Packet_reader r;
+  std::auto_ptr<http::Packet> res(r.read_response(out, false));
+  BOOST_REQUIRE(res.get());
+  BOOST_CHECK_EQUAL(res->content(), "firstsecond");
+}
+
 // vim:ts=2:sw=2:et
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Runs client-test against server-test in default configuration and
+# with each of optional server features enabled.
+# Usage: run-server-tests.sh [port [numthreads]]
+# Run it from the directory with built tests.
+
+PORT=${1:-3344}
+THREADS=${2:-1}
+STATUS=0
+
+run() {
+  ./server-test --port $PORT --numthreads $THREADS "$@" > server-test.log 2>&1 &
+  SERVER=$!
+  sleep 1
+
+  CLIENT_OPTS=""
+  case "$*" in
+    *--memoize*) CLIENT_OPTS="--memoize 1" ;;
+  esac
+
+  echo "Server options: --numthreads $THREADS $*"
+  ./client-test -- --host 127.0.0.1 --port $PORT $CLIENT_OPTS || STATUS=1
+
+  kill $SERVER
+  wait $SERVER 2>/dev/null
+}
+
+run
+run --response-chunk-sz 16384
+run --request-arena 1
+run --memoize 1
+
+exit $STATUS
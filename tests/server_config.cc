@@ -17,14 +17,20 @@ Test_server_config::Test_server_config(int argc, char** argv):
   port(0),
   numthreads(1),
   use_ssl(false),
-  omit_string_tags(false)
+  omit_string_tags(false),
+  response_chunk_sz(0),
+  request_arena(false),
+  memoize(false)
 {
   options_description opts;
   opts.add_options()
     ("port", value<int>(&port))
     ("numthreads", value<int>(&numthreads))
     ("use-ssl", value<bool>(&use_ssl))
-    ("omit-string-tags", value<bool>(&omit_string_tags));
+    ("omit-string-tags", value<bool>(&omit_string_tags))
+    ("response-chunk-sz", value<int>(&response_chunk_sz))
+    ("request-arena", value<bool>(&request_arena))
+    ("memoize", value<bool>(&memoize));
 
   variables_map vm;
   store(parse_command_line(argc, argv, opts), vm);
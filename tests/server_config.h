@@ -11,6 +11,11 @@ struct Test_server_config {
   int numthreads;
   bool use_ssl;
   bool omit_string_tags;
+  //! Stream responses by chunks of this size, zero disables streaming.
+  int response_chunk_sz;
+  bool request_arena;
+  //! Cache results of count_calls method.
+  bool memoize;
 
   Test_server_config(int argc, char** argv);
 };
@@ -9,6 +9,7 @@
 #include "libiqxmlrpc/https_server.h"
 #include "libiqxmlrpc/executor.h"
 #include "libiqxmlrpc/auth_plugin.h"
+#include "libiqxmlrpc/memoizing_interceptor.h"
 #include "server_config.h"
 #include "methods.h"
 #include "libiqxmlrpc/xheaders.h"
@@ -68,6 +69,13 @@ public:
   }
 };
 
+Memoizing_interceptor* memoizer = 0;
+
+void memo_invalidate(Method*, const Param_list& args, Value&)
+{
+  memoizer->invalidate(args[0].get_string());
+}
+
 class PermissiveAuthPlugin: public iqxmlrpc::Auth_Plugin_base {
 public:
   PermissiveAuthPlugin() {}
@@ -126,14 +134,25 @@ Test_server::Test_server(const Test_server_config& conf):
   impl_->push_interceptor(new LogInterceptor);
   impl_->push_interceptor(new TraceInterceptor);
 
+  if (conf.memoize)
+  {
+    memoizer = new Memoizing_interceptor(1024*1024);
+    memoizer->cache_method("count_calls", 60);
+    impl_->push_interceptor(memoizer);
+  }
+
   impl_->log_errors( &std::cerr );
   impl_->enable_introspection();
   impl_->set_max_request_sz(1024*1024);
+  impl_->set_response_chunk_sz(conf.response_chunk_sz);
+  impl_->set_request_arena(conf.request_arena);
   impl_->set_verification_level(http::HTTP_CHECK_STRICT);
 
   impl_->set_auth_plugin(auth_plugin_);
 
   register_user_methods(impl());
+  if (memoizer)
+    register_method(impl(), "memo.invalidate", memo_invalidate);
 }
 
 void Test_server::work()
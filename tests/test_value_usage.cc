@@ -1,10 +1,17 @@
 #define BOOST_TEST_MODULE value_test
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <vector>
 #include <algorithm>
 #include <boost/test/test_tools.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/unordered_set.hpp>
 #include "libiqxmlrpc/value.h"
+#include "libiqxmlrpc/response.h"
+#include "libiqxmlrpc/value_traits.h"
 
 using namespace boost::unit_test;
 using namespace iqxmlrpc;
@@ -129,6 +136,13 @@ BOOST_AUTO_TEST_CASE( struct_test )
     BOOST_CHECK( s.find("nonexistent") != s.end() );
     s.erase( "nonexistent" );
     BOOST_CHECK( s.find("nonexistent") == s.end() );
+
+    // Members are changed in place, names are read-only.
+    s.insert( "mutable", 0 );
+    Struct::iterator mi = s.find("mutable");
+    *mi->second = 1;
+    BOOST_CHECK_EQUAL( s["mutable"].get_int(), 1 );
+    s.erase( "mutable" );
   }
 
   {
@@ -153,6 +167,32 @@ BOOST_AUTO_TEST_CASE( struct_test )
     check_struct_value(s1);
   }
 
+  {
+    BOOST_TEST_CHECKPOINT("Struct members order");
+    Struct s1;
+    s1.insert("c", 3);
+    s1.insert("a", 1);
+    s1.insert("d", 4);
+    s1.insert("b", 0);
+    s1.insert("b", 2);
+    BOOST_CHECK_EQUAL(s1.size(), 4u);
+
+    std::string names;
+    for (Struct::const_iterator i = s1.begin(); i != s1.end(); ++i)
+    {
+      names += i->first;
+      BOOST_CHECK_EQUAL(i->second->get_int(), i->first[0] - 'a' + 1);
+    }
+    BOOST_CHECK_EQUAL(names, "abcd");
+
+    s1.erase("a");
+    s1.erase("x");
+    BOOST_CHECK(!s1.has_field("a"));
+    BOOST_CHECK(!s1.has_field("x"));
+    BOOST_CHECK_EQUAL(s1["d"].get_int(), 4);
+    BOOST_CHECK_THROW(s1["a"], Struct::No_field);
+  }
+
   {
     Struct s;
     s.insert("pages", 0);
@@ -169,18 +209,475 @@ BOOST_AUTO_TEST_CASE( struct_test )
   BOOST_CHECK_EQUAL(v.type_name(), "struct");
 }
 
-#if 0
+BOOST_AUTO_TEST_CASE( date_time_test )
+{
+  BOOST_TEST_MESSAGE("Date_time test...");
+
+  Date_time d(std::string("19980717T14:08:55"));
+  BOOST_CHECK_EQUAL(d.to_string(), "19980717T14:08:55");
+  BOOST_CHECK_EQUAL(d.get_tm().tm_year, 98);
+  BOOST_CHECK_EQUAL(d.get_tm().tm_mon, 6);
+  BOOST_CHECK_EQUAL(d.get_tm().tm_mday, 17);
+  BOOST_CHECK_EQUAL(d.get_tm().tm_hour, 14);
+  BOOST_CHECK_EQUAL(d.get_tm().tm_min, 8);
+  BOOST_CHECK_EQUAL(d.get_tm().tm_sec, 55);
+
+  struct tm t = d.get_tm();
+  BOOST_CHECK_EQUAL(Date_time(&t).to_string(), "19980717T14:08:55");
+  t.tm_sec = 5;
+  BOOST_CHECK_EQUAL(Date_time(&t).to_string(), "19980717T14:08:05");
+  t.tm_year = -1800;
+  BOOST_CHECK_EQUAL(Date_time(&t).to_string(), "01000717T14:08:05");
+
+  BOOST_CHECK_EQUAL(Date_time(false).to_string().length(), 17);
+
+  const char* bad[] = {
+    "", "19980717T14:08:5", "19980717T14:08:555", "19980717 14:08:55",
+    "19980717T14-08:55", "1998O717T14:08:55", "19980717T14:08:5x",
+    "18991231T14:08:55", "19981317T14:08:55", "19980700T14:08:55",
+    "19980717T24:08:55", "19980717T14:60:55", "19980717T14:08:62",
+    "1998-7-17T4:08:55", 0
+  };
+
+  for (const char** i = bad; *i; ++i)
+    BOOST_CHECK_THROW(Date_time(std::string(*i)), Date_time::Malformed_iso8601);
+}
+
+BOOST_AUTO_TEST_CASE( inline_scalar_test )
+{
+  BOOST_TEST_MESSAGE("Inline scalars test...");
+
+  std::string short_str(15, 's');
+  std::string long_str(16, 'l');
+
+  Value vs(short_str);
+  Value vl(long_str);
+  BOOST_CHECK(vs.is_string());
+  BOOST_CHECK(vl.is_string());
+  BOOST_CHECK_EQUAL(vs.get_string(), short_str);
+  BOOST_CHECK_EQUAL(vl.get_string(), long_str);
+  BOOST_CHECK_EQUAL(Value("").get_string(), "");
+
+  // Scalar objects, as parser produces them, are folded into Value.
+  Value vi(new Int(7));
+  Value vb(new Bool(true));
+  Value vn(new Nil());
+  Value vfs(new String(short_str));
+  Value vfl(new String(long_str));
+  BOOST_CHECK_EQUAL(vi.get_int(), 7);
+  BOOST_CHECK(vb.get_bool());
+  BOOST_CHECK(vn.is_nil());
+  BOOST_CHECK_EQUAL(vfs.get_string(), short_str);
+  BOOST_CHECK_EQUAL(vfl.get_string(), long_str);
+  BOOST_CHECK_EQUAL(vn.type_name(), "nil");
+  BOOST_CHECK_EQUAL(vb.type_name(), "boolean");
+
+  BOOST_CHECK_THROW(vi.get_string(), Value::Bad_cast);
+  BOOST_CHECK_THROW(vs.get_int(), Value::Bad_cast);
+  BOOST_CHECK_THROW(vi.the_array(), Value::Bad_cast);
+  BOOST_CHECK(!vi.is_array());
+  BOOST_CHECK(!vs.is_int());
+
+  // Assignments between inline and heap values.
+  Value v = vl;
+  BOOST_CHECK_EQUAL(v.get_string(), long_str);
+  v = vi;
+  BOOST_CHECK_EQUAL(v.get_int(), 7);
+  v = Array();
+  BOOST_CHECK(v.is_array());
+  v.push_back(vs);
+  v.push_back(vl);
+  v = v[0];
+  BOOST_CHECK_EQUAL(v.get_string(), short_str);
+
+  std::ostringstream ss;
+  print_value(vs, ss);
+  BOOST_CHECK_EQUAL(ss.str(), "'" + short_str + "'");
+}
+
+BOOST_AUTO_TEST_CASE( copy_on_write_test )
+{
+  BOOST_TEST_MESSAGE("Copy-on-write test...");
+
+  Struct inner;
+  inner.insert("name", std::string(100, 'n'));
+  Array a;
+  a.push_back(inner);
+  a.push_back(inner);
+
+  Value orig(a);
+  const Value& corig = orig;
+  Value copy(orig);
+  const Value& ccopy = copy;
+
+  // Copy shares the tree until it is modified.
+  BOOST_CHECK_EQUAL(&ccopy[0], &corig[0]);
+
+  copy[1]["name"] = "changed";
+  BOOST_CHECK_EQUAL(ccopy[1]["name"].get_string(), "changed");
+  BOOST_CHECK_EQUAL(corig[1]["name"].get_string(), std::string(100, 'n'));
+
+  // Only the modified path is copied.
+  BOOST_CHECK(&ccopy[0] != &corig[0]);
+  BOOST_CHECK_EQUAL(&ccopy[0]["name"], &corig[0]["name"]);
+
+  // Reference obtained before copying must not affect the copy.
+  Value& elem = orig[0];
+  Value copy2(orig);
+  elem["name"] = "orig";
+  BOOST_CHECK_EQUAL(orig[0]["name"].get_string(), "orig");
+  BOOST_CHECK_EQUAL(copy2[0]["name"].get_string(), std::string(100, 'n'));
+
+  Struct& st = copy2[0].the_struct();
+  Value copy3(copy2);
+  st.insert("id", 1);
+  BOOST_CHECK(copy2[0].has_field("id"));
+  BOOST_CHECK(!copy3[0].has_field("id"));
+
+  copy3.push_back(Nil());
+  BOOST_CHECK_EQUAL(copy3.size(), 3u);
+  BOOST_CHECK_EQUAL(copy2.size(), 2u);
+
+  // Const iteration gives read-only members, changes go through
+  // the copy's own struct.
+  Struct list;
+  list.insert("items", Array());
+  Value sorig(list);
+  Value scopy(sorig);
+  const Value& csorig = sorig;
+
+  Struct::const_iterator ci = csorig.the_struct().begin();
+  const Value* cv = ci->second;
+  BOOST_CHECK_EQUAL(cv, &csorig["items"]);
+
+  Struct::iterator mi = scopy.the_struct().find("items");
+  mi->second->push_back(1);
+  BOOST_CHECK_EQUAL(scopy["items"].size(), 1u);
+  BOOST_CHECK_EQUAL(csorig["items"].size(), 0u);
+  BOOST_CHECK(mi != scopy.the_struct().end());
+}
+
+BOOST_AUTO_TEST_CASE( arena_test )
+{
+  BOOST_TEST_MESSAGE("Value_arena test...");
+
+  Value_arena arena(1024);
+  std::auto_ptr<Value> tree;
+
+  {
+    Value_arena::Scope scope(&arena);
+    BOOST_CHECK_EQUAL(Value_arena::current(), &arena);
+
+    Array a;
+    for (int i = 0; i < 100; ++i)
+    {
+      Struct s;
+      s.insert("id", i);
+      s.insert("name", std::string(100, 'x'));
+      a.push_back(s);
+    }
+    tree.reset(new Value(a));
+  }
+
+  BOOST_CHECK(!Value_arena::current());
+  BOOST_CHECK(arena.capacity() > 0);
+
+  // Copies made outside of scope are on the heap and outlive the arena.
+  size_t capacity = arena.capacity();
+  Value copy(*tree);
+  BOOST_CHECK_EQUAL(arena.capacity(), capacity);
+  const Value& ctree = *tree;
+  const Value& ccopy = copy;
+  BOOST_CHECK(&ccopy[0]["name"] != &ctree[0]["name"]);
+
+  // Mixed trees are fine.
+  (*tree)[0]["id"] = 1000;
+  BOOST_CHECK_EQUAL((*tree)[0]["id"].get_int(), 1000);
+  BOOST_CHECK_EQUAL((*tree)[99]["id"].get_int(), 99);
+  BOOST_CHECK_EQUAL((*tree)[99]["name"].get_string().size(), 100u);
+  tree.reset();
+
+  BOOST_CHECK_EQUAL(copy.size(), 100);
+  BOOST_CHECK_EQUAL(copy[0]["id"].get_int(), 0);
+}
+
+#ifdef LIBIQXMLRPC_HAS_RVALUE_REFS
+BOOST_AUTO_TEST_CASE( move_test )
+{
+  BOOST_TEST_MESSAGE("Move semantics test...");
+
+  Array inner;
+  inner.push_back(Value("first"));
+  inner.emplace_back(std::string("second"));
+  const Value* first = &inner[0];
+
+  Struct s;
+  s.insert("inner", Value(std::move(inner)));
+  s.emplace("id", 42);
+  BOOST_CHECK_EQUAL(inner.size(), 0u);
+
+  // Elements are not copied while tree grows.
+  BOOST_CHECK_EQUAL(&s["inner"][0], first);
+  BOOST_CHECK_EQUAL(s["inner"][1].get_string(), "second");
+  BOOST_CHECK_EQUAL(s["id"].get_int(), 42);
+
+  Array outer;
+  outer.emplace_back(std::move(s));
+  BOOST_CHECK_EQUAL(s.size(), 0u);
+  BOOST_CHECK_EQUAL(&outer[0]["inner"][0], first);
+
+  Value v(std::move(outer));
+  BOOST_CHECK_EQUAL(&v[0]["inner"][0], first);
+
+  Value moved(std::move(v));
+  BOOST_CHECK_EQUAL(&moved[0]["inner"][0], first);
+
+  v = Value(1);
+  BOOST_CHECK_EQUAL(v.get_int(), 1);
+
+  v = std::move(moved);
+  BOOST_CHECK_EQUAL(&v[0]["inner"][0], first);
+  BOOST_CHECK(moved.is_int());
+
+  std::vector<Value> pl;
+  pl.push_back(std::move(v));
+  pl.push_back(Value("x"));
+  pl.push_back(Value(Nil()));
+  BOOST_CHECK_EQUAL(&pl[0][0]["inner"][0], first);
+}
+#endif
+
 BOOST_AUTO_TEST_CASE( binary_test )
 {
   BOOST_TEST_MESSAGE("Binary_data test...");
-  BOOST_FAIL("TEST NOT IMPLEMENTED!");
+
+  std::auto_ptr<Binary_data> bin(Binary_data::from_data("Hello, world"));
+  BOOST_CHECK_EQUAL(bin->get_base64(), "SGVsbG8sIHdvcmxk");
+
+  std::auto_ptr<Binary_data> dec(Binary_data::from_base64("SGVs\nbG8s IHdv\ncmxk"));
+  BOOST_CHECK_EQUAL(dec->get_data(), "Hello, world");
+  BOOST_CHECK_THROW(Binary_data::from_base64("SGVsb"), Binary_data::Malformed_base64);
+
+  // Copies and slices share the buffer.
+  Value v(*bin);
+  Binary_data copy = v.get_binary();
+  BOOST_CHECK_EQUAL((const void*)copy.data(), (const void*)bin->data());
+
+  std::auto_ptr<Binary_data> part(copy.slice(7, 5));
+  BOOST_CHECK_EQUAL((const void*)part->data(), (const void*)(bin->data() + 7));
+  BOOST_CHECK_EQUAL(part->get_data(), "world");
+  BOOST_CHECK_EQUAL(part->get_base64(), "d29ybGQ=");
+  BOOST_CHECK_THROW(part->slice(3, 3), Binary_data::Out_of_range);
+
+  bin.reset();
+  v = Value(0);
+  BOOST_CHECK_EQUAL(part->get_data(), "world");
+
+  // Buffer without owner is copied.
+  char user_buf[] = "user";
+  std::auto_ptr<Binary_data> user(
+    Binary_data::from_buffer(user_buf, 4, boost::shared_ptr<const void>()));
+  BOOST_CHECK((const void*)user->data() != (const void*)user_buf);
+  user_buf[0] = 'x';
+  BOOST_CHECK_EQUAL(user->get_base64(), "dXNlcg==");
+
+  // Owned buffer is not copied.
+  boost::shared_ptr<std::vector<char> > owned(new std::vector<char>(3, 'x'));
+  const char* owned_data = &(*owned)[0];
+  std::auto_ptr<Binary_data> shared(
+    Binary_data::from_buffer(owned_data, owned->size(), owned));
+  owned.reset();
+  BOOST_CHECK_EQUAL((const void*)shared->data(), (const void*)owned_data);
+  BOOST_CHECK_EQUAL(shared->get_data(), "xxx");
 }
 
-BOOST_AUTO_TEST_CASE( date_time_test )
+BOOST_AUTO_TEST_CASE( mapped_file_test )
 {
-  BOOST_TEST_MESSAGE("Date_time test...");
-  BOOST_FAIL("TEST NOT IMPLEMENTED!");
+  std::string content(100000, '\0');
+  for (size_t i = 0; i < content.size(); ++i)
+    content[i] = char(i * 7);
+
+  const char* path = "binary_data_test.bin";
+  {
+    std::ofstream f(path, std::ios::out | std::ios::binary);
+    f.write(content.data(), content.size());
+  }
+
+  std::auto_ptr<Binary_data> mapped(Binary_data::from_file(path));
+  std::auto_ptr<Binary_data> copied(Binary_data::from_data(content));
+  std::remove(path);
+
+  BOOST_CHECK_EQUAL(mapped->size(), content.size());
+  BOOST_CHECK(mapped->get_data() == content);
+  BOOST_CHECK(mapped->get_base64() == copied->get_base64());
+
+  BOOST_CHECK_THROW(Binary_data::from_file("no/such/file"), Binary_data::Cannot_map_file);
+}
+
+namespace app {
+
+struct Point {
+  int x;
+  double y;
+  std::string label;
+};
+
+struct Shape {
+  std::vector<Point> points;
+  std::map<std::string, int> tags;
+  bool closed;
+};
+
+} // namespace app
+
+IQXMLRPC_STRUCT(app::Point, (x)(y)(label))
+IQXMLRPC_STRUCT(app::Shape, (points)(tags)(closed))
+
+BOOST_AUTO_TEST_CASE( struct_mapping_test )
+{
+  app::Shape shape;
+  shape.closed = true;
+  shape.tags["color"] = 3;
+  for (int i = 0; i < 3; ++i) {
+    app::Point p = { i, i * 0.5, "p" };
+    shape.points.push_back(p);
+  }
+
+  Value v(to_value(shape));
+  BOOST_CHECK(v.is_struct());
+  BOOST_CHECK_EQUAL(v["points"][2]["x"].get_int(), 2);
+  BOOST_CHECK_EQUAL(v["tags"]["color"].get_int(), 3);
+
+  std::string xml = dump_response(Response(new Value(v)));
+  app::Shape decoded = parse_response_as<app::Shape>(xml);
+  BOOST_CHECK(decoded.closed);
+  BOOST_REQUIRE_EQUAL(decoded.points.size(), 3u);
+  BOOST_CHECK_EQUAL(decoded.points[2].y, 1.0);
+  BOOST_CHECK_EQUAL(decoded.points[1].label, "p");
+  BOOST_CHECK(decoded.tags == shape.tags);
+
+  // Unmapped members are ignored, missing ones are reported.
+  v["points"][0].insert("z", 10);
+  BOOST_CHECK_EQUAL(value_cast<app::Shape>(v).points[0].x, 0);
+  Value no_label = v["points"][1];
+  no_label.the_struct().erase("label");
+  BOOST_CHECK_THROW(value_cast<app::Point>(no_label), Struct::No_field);
+  BOOST_CHECK_THROW(value_cast<app::Point>(Value(1)), Value::Bad_cast);
+
+  boost::shared_ptr<const std::string> buf(new std::string(xml));
+  BOOST_CHECK_EQUAL(parse_response_lazy(buf).value_as<app::Shape>().points.size(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE( value_traits_test )
+{
+  std::map<std::string, std::vector<int> > m;
+  m["a"].push_back(1);
+  m["a"].push_back(2);
+  m["b"];
+
+  Value v(Value_traits<std::map<std::string, std::vector<int> > >::to_value(m));
+  BOOST_CHECK(v.is_struct());
+  BOOST_CHECK_EQUAL(v["a"][1].get_int(), 2);
+  BOOST_CHECK((Value_traits<std::map<std::string, std::vector<int> > >::from_value(v) == m));
+
+  BOOST_CHECK_THROW(Value_traits<std::vector<std::string> >::from_value(v["a"]), Value::Bad_cast);
+  BOOST_CHECK_EQUAL(Value_traits<std::vector<int> >::type_name(), std::string("array"));
+
+  // Numeric elements are packed.
+  Value packed(Value_traits<std::vector<int> >::to_value(m["a"]));
+  BOOST_REQUIRE(packed.is_array());
+  BOOST_CHECK(packed.the_array().packed_as<int>());
+  BOOST_CHECK(Value_traits<std::vector<int> >::from_value(packed) == m["a"]);
+
+  std::vector<bool> flags(3, true);
+  flags[1] = false;
+  Value packed_flags(Value_traits<std::vector<bool> >::to_value(flags));
+  BOOST_CHECK(packed_flags.the_array().packed_as<bool>());
+  BOOST_CHECK_EQUAL(packed_flags[1].get_bool(), false);
+  BOOST_CHECK(Value_traits<std::vector<bool> >::from_value(packed_flags) == flags);
+
+  Value regular_flags = Array();
+  regular_flags.push_back(true);
+  BOOST_CHECK(Value_traits<std::vector<bool> >::from_value(regular_flags) == std::vector<bool>(1, true));
+
+  // Value is passed through as is.
+  BOOST_CHECK(Value_traits<Value>::from_value(v) == v);
+  BOOST_CHECK(Value_traits<Value>::to_value(v["a"]) == v["a"]);
+}
+
+BOOST_AUTO_TEST_CASE( hash_test )
+{
+  Value v = Struct();
+  v.insert("name", "a rather long string value");
+  v.insert("short", "abc");
+  v.insert("list", Array());
+  v["list"].push_back(1);
+  v["list"].push_back(int64_t(1));
+  v["list"].push_back(1.0);
+  v["list"].push_back(Nil());
+  v.insert("blob", Binary_data::from_data("\0\1\2", 3));
+
+  std::string xml = dump_response(Response(new Value(v)));
+  Response r = parse_response(xml);
+  const Value& parsed = r.value();
+  BOOST_CHECK(parsed == v);
+  BOOST_CHECK_EQUAL(parsed.hash(), v.hash());
+
+  boost::shared_ptr<const std::string> buf(new std::string(xml));
+  Response lazy = parse_response_lazy(buf);
+  BOOST_CHECK(lazy.value() == parsed);
+  BOOST_CHECK_EQUAL(lazy.value().hash(), parsed.hash());
+
+  // Types must match.
+  BOOST_CHECK(Value(1) != Value(int64_t(1)));
+  BOOST_CHECK(Value(1) != Value(1.0));
+  BOOST_CHECK(v["list"] != Value(Array()));
+  BOOST_CHECK(Value(std::string(20, 'x')) == Value(std::string(20, 'x')));
+
+  // Cached hash does not survive modification.
+  Value copy = parsed;
+  copy["list"][0] = 2;
+  BOOST_CHECK(copy != parsed);
+  BOOST_CHECK(copy.hash() != parsed.hash());
+  BOOST_CHECK_EQUAL(parsed.hash(), v.hash());
+
+  Value modified(r.value());
+  modified.the_struct().insert("short", "abd");
+  BOOST_CHECK(modified != v);
+  modified["short"] = "abc";
+  BOOST_CHECK(modified == v);
+  BOOST_CHECK_EQUAL(modified.hash(), v.hash());
+
+  // Members changed in place are seen by hash.
+  Value changed(r.value());
+  Struct::iterator li = changed.the_struct().find("list");
+  li->second->push_back(2);
+  Value expected(v);
+  expected["list"].push_back(2);
+  BOOST_CHECK(changed == expected);
+  BOOST_CHECK_EQUAL(changed.hash(), expected.hash());
+  BOOST_CHECK(r.value() == v);
+  BOOST_CHECK_EQUAL(r.value().hash(), v.hash());
+
+  // Packed arrays are equal to regular ones.
+  Value::pack_numeric_arrays(true);
+  Value ints = Array();
+  for (int i = 0; i < 3; ++i)
+    ints.push_back(i);
+  Value packed = parse_response(dump_response(Response(new Value(ints)))).value();
+  Value::pack_numeric_arrays(false);
+  BOOST_REQUIRE(packed.the_array().packed());
+  BOOST_CHECK(packed == ints);
+  BOOST_CHECK(ints == packed);
+  BOOST_CHECK_EQUAL(packed.hash(), ints.hash());
+
+  boost::unordered_set<Value> set;
+  set.insert(parsed);
+  set.insert(v);
+  set.insert(packed);
+  set.insert(ints);
+  BOOST_CHECK_EQUAL(set.size(), 2u);
+  BOOST_CHECK(set.count(copy) == 0);
 }
-#endif
 
 // vim:ts=2:sw=2:et